@@ -11,13 +11,15 @@ ads1115.c
 		SDA - 94h (see special note in the data sheet if you use this)
 
 	We use only two registers, CONFIG and CONVERSION and don't look at the
-	threshold registers.
+	threshold registers. The ALERT/RDY pins aren't connected on the board.
 ------------------------------------------------------------------------------*/
 
 #include "globals.h"
 #include "errors.h"
 #include "ads1115.h"
 #include "twi.h"
+#include "wdt.h"
+#include "bod.h"
 
 /*------------------------------------------------------------------------------
 float read_ADS1115(uint8_t addr, uint8_t gain, uint8_t pins, uint8_t datarate)
@@ -191,7 +193,12 @@ uint8_t read_ADS1115(uint8_t addr, uint8_t gain, uint8_t pins,
 	_delay_us(25);									// Power-up time
 
 	converting = YES;
+	TRACE_WDT(TRCADS1115);
 	while (converting) {							// Wait for conversion to finish
+		if (powerFail) {							// Give way to save_POWERFAIL
+			stop_TWI();
+			return(ERROR);
+		}
 		start_TWI(addr, TWIREAD);
 		flag = readlast_TWI();
 		if (flag & 0b10000000) {
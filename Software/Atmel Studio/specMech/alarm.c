@@ -0,0 +1,190 @@
+/*------------------------------------------------------------------------------
+alarm.c
+	Limit alarms checked by the sensors themselves.
+
+	The MCP9808 board temperature sensor compares every conversion with a
+	window (alarmLow, alarmHigh) and holds its ALERT output (T-ALERT, PC2)
+	low while the temperature is outside it. The PORTC interrupt flags each
+	edge and the main loop sends an ALM event going out and coming back.
+
+	The MMA8451 transient detector latches any acceleration change bigger
+	than its threshold. Its INT pins aren't connected on this board, so the
+	latch (one register) is read once a second instead of reading samples.
+
+	The ADS1115 ALERT/RDY pins aren't connected either, and the ADCs are
+	switched between channels for single-shot conversions, so there is no
+	comparator to hand the vacuum limits to.
+
+	Events:
+		ALM,<time>,temperature,<high|low|ok>,<temperature>,C
+		ALM,<time>,bump,<axes that moved (x, y, z)>
+------------------------------------------------------------------------------*/
+
+#include "globals.h"
+#include "errors.h"
+#include "ds3231.h"
+#include "mcp9808.h"
+#include "mma8451.h"
+#include "outbox.h"
+#include "usart.h"
+#include "alarm.h"
+
+volatile uint8_t alarmTemp;			// T-ALERT changed
+uint8_t timerALARM;					// Seconds since the bump latch was read
+uint8_t alarmBump;					// Transient threshold (0.063 g units), 0 is off
+float alarmLow, alarmHigh;			// Board temperature window (C)
+
+/*------------------------------------------------------------------------------
+void check_ALARM(void)
+	Send the events for what the sensors flagged. Called from the main loop
+	when T-ALERT changed or every ALMPOLL seconds.
+------------------------------------------------------------------------------*/
+void check_ALARM(void)
+{
+
+	char outbuf[BUFSIZE], currenttime[20], moved[4];
+	const char format_ALT[] = "ALM,%s,temperature,%s,%3.1f,C";
+	const char format_ALB[] = "ALM,%s,bump,%s";
+	uint8_t src, n;
+	float temperature;
+
+	if (alarmTemp) {
+		alarmTemp = NO;
+		read_MCP9808(&temperature);
+		get_time(currenttime);
+		if (PORTC.IN & PIN2_bm) {			// Back inside the window
+			sprintf(outbuf, format_ALT, currenttime, "ok", temperature);
+		} else {
+			sprintf(outbuf, format_ALT, currenttime,
+				(temperature < alarmLow) ? "low" : "high", temperature);
+		}
+		printEvent(outbuf);
+	}
+
+	if (timerALARM >= ALMPOLL) {
+		timerALARM = 0;
+		if (alarmBump == 0) {
+			return;
+		}
+		if (read_MMA8451(MMA8451ADDR, MMA8451TRANSSRC, &src, 1) == ERROR) {
+			return;
+		}
+		if (!(src & 0b01000000)) {			// EA, no event latched
+			return;
+		}
+		n = 0;
+		if (src & 0b00000010) {
+			moved[n++] = 'x';
+		}
+		if (src & 0b00001000) {
+			moved[n++] = 'y';
+		}
+		if (src & 0b00100000) {
+			moved[n++] = 'z';
+		}
+		moved[n] = '\0';
+		get_time(currenttime);
+		sprintf(outbuf, format_ALB, currenttime, moved);
+		printEvent(outbuf);
+	}
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t init_ALARM(void)
+	Program the default limits into the sensors and turn on the T-ALERT
+	interrupt (both edges, the line is open drain with a pullup). If the
+	temperature is already outside the window it's reported once the reboot
+	is acknowledged.
+------------------------------------------------------------------------------*/
+uint8_t init_ALARM(void)
+{
+
+	uint8_t retval;
+
+	alarmLow = ALMTEMPLOW;
+	alarmHigh = ALMTEMPHIGH;
+	alarmBump = ALMBUMP;
+	timerALARM = 0;
+
+	retval = alert_MCP9808(alarmLow, alarmHigh);
+	if (transient_MMA8451(alarmBump) == ERROR) {
+		retval = ERROR;
+	}
+
+	PORTC.DIRCLR = PIN2_bm;
+	PORTC.PIN2CTRL = PORT_PULLUPEN_bm | PORT_ISC_BOTHEDGES_gc;
+	alarmTemp = (PORTC.IN & PIN2_bm) ? NO : YES;
+
+	return(retval);
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t set_ALARM(char *value)
+	Change a limit (the sa command)
+
+	Input:
+		value - t<low>,<high> for the board temperature window in C, or
+			b<cm/s/s> for the bump threshold (0 turns it off)
+
+	Returns:
+		ERROR for a bad value or if the sensor couldn't be written
+		NOERROR otherwise
+------------------------------------------------------------------------------*/
+uint8_t set_ALARM(char *value)
+{
+
+	char *end;
+	float low, high, bump;
+
+	switch (value[0]) {
+		case 't':
+			low = strtod(&value[1], &end);
+			if ((end == &value[1]) || (*end != ',')) {
+				break;
+			}
+			value = end + 1;
+			high = strtod(value, &end);
+			if ((end == value) || (*end != '\0') || (high <= low)) {
+				break;
+			}
+			if (alert_MCP9808(low, high) == ERROR) {
+				printError(ERR_ALARMTWI, "alarm: MCP9808 didn't take the limits");
+				return(ERROR);
+			}
+			alarmLow = low;
+			alarmHigh = high;
+			return(NOERROR);
+
+		case 'b':
+			bump = strtod(&value[1], &end);
+			if ((end == &value[1]) || (*end != '\0') || (bump < 0.0) ||
+				((bump / MMA8451THSSTEP) > 127.0)) {
+				break;
+			}
+			if (transient_MMA8451((uint8_t) ((bump / MMA8451THSSTEP) + 0.5)) == ERROR) {
+				printError(ERR_ALARMTWI, "alarm: MMA8451 didn't take the threshold");
+				return(ERROR);
+			}
+			alarmBump = (uint8_t) ((bump / MMA8451THSSTEP) + 0.5);
+			return(NOERROR);
+
+		default:
+			break;
+	}
+
+	printError(ERR_ALARMVALUE, "alarm: use t<low>,<high> or b<cm/s/s>");
+	return(ERROR);
+
+}
+
+ISR(PORTC_PORT_vect)
+{
+
+	if (PORTC.INTFLAGS & PIN2_bm) {		// MCP9808 T-ALERT
+		PORTC.INTFLAGS = PIN2_bm;		// Clear the interrupt flag
+		alarmTemp = YES;
+	}
+
+}
@@ -0,0 +1,16 @@
+#ifndef ALARMH
+#define ALARMH
+
+#define ALMTEMPLOW		(-10.0)	// Default board temperature window (C)
+#define ALMTEMPHIGH		(45.0)
+#define ALMBUMP			4		// Default bump threshold (0.063 g units, ~250 cm/s/s)
+#define ALMPOLL			1		// Read the bump latch this often (sec)
+
+extern volatile uint8_t alarmTemp;
+extern uint8_t timerALARM;
+
+void check_ALARM(void);
+uint8_t init_ALARM(void);
+uint8_t set_ALARM(char*);
+
+#endif
@@ -0,0 +1,73 @@
+/*------------------------------------------------------------------------------
+bod.c
+	Power-fail warning from the brown-out detector's voltage level monitor
+	(VLM). The BOD itself has to be enabled in the BODCFG fuse (active mode)
+	or the VLM never fires. init_BOD checks, and without it the encoders go
+	on being saved every SAVEENCODERFREQUENCY seconds (see init_MOTORS).
+------------------------------------------------------------------------------*/
+
+#include "globals.h"
+#include "fram.h"
+#include "pneu.h"
+#include "roboclaw.h"
+#include "trajectory.h"
+#include "usage.h"
+#include "bod.h"
+
+volatile uint8_t powerFail;		// Set by the VLM interrupt, cleared by save_POWERFAIL
+uint8_t bodArmed;				// The fuse enables the BOD, so the VLM works
+
+/*------------------------------------------------------------------------------
+void init_BOD(void)
+	Interrupt when VDD falls to 25% above the BOD level. That leaves the
+	hold-up time of the supply capacitors to get the state into FRAM. BOD
+	CTRLA is loaded from the BODCFG fuse at reset; unless it says the BOD
+	is always on, the VLM is left off and bodArmed is NO.
+------------------------------------------------------------------------------*/
+void init_BOD(void)
+{
+
+	powerFail = NO;
+	if ((BOD.CTRLA & BOD_ACTIVE_gm) != BOD_ACTIVE_ENABLED_gc) {
+		bodArmed = NO;
+		return;
+	}
+	bodArmed = YES;
+	BOD.VLMCTRLA = BOD_VLMLVL_25ABOVE_gc;
+	BOD.INTCTRL = BOD_VLMCFG_BELOW_gc | BOD_VLMIE_bm;
+
+}
+
+/*------------------------------------------------------------------------------
+void save_POWERFAIL(void)
+	Write what would be lost to FRAM, most important first: the encoder
+	positions, the commanded valve pattern (pneuValves, read back by
+	init_PNEU), the usage counters, then anything still buffered in RAM.
+	Called from the main loop as soon as the VLM interrupt sets powerFail.
+	It's all TWI writes from RAM: the encoders are the last counts read
+	(saveFRAM_MOTORLast), since reading the RoboClaws takes too long and
+	they may already be going down. Errors are ignored; there's no time to
+	retry.
+------------------------------------------------------------------------------*/
+void save_POWERFAIL(void)
+{
+
+	uint8_t valves[2];
+
+	powerFail = NO;
+	saveFRAM_MOTORLast();
+	valves[0] = pneuValves;
+	valves[1] = ~pneuValves;
+	write_FRAM(FRAMTWIADDR, VALVEFRAMADDR, valves, 2);
+	save_USAGE();
+	flush_TRAJECTORY();
+
+}
+
+ISR(BOD_VLM_vect)
+{
+
+	BOD.INTFLAGS = BOD_VLMIF_bm;	// Clear the interrupt flag
+	powerFail = YES;
+
+}
@@ -0,0 +1,10 @@
+#ifndef BODH
+#define BODH
+
+extern volatile uint8_t powerFail;
+extern uint8_t bodArmed;
+
+void init_BOD(void);
+void save_POWERFAIL(void);
+
+#endif /* BODH */
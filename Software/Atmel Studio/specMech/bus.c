@@ -0,0 +1,81 @@
+/*------------------------------------------------------------------------------
+bus.c
+	Bus ownership. Each bus (TWI, USART1, USART3) has an owner flag so work
+	on one bus can be started and left running while another bus is used.
+	An interrupt routine that finds its bus owned hands its work to
+	defer_BUS instead of breaking into the transfer; the work runs as soon
+	as the owner releases the bus.
+------------------------------------------------------------------------------*/
+
+#include "globals.h"
+#include "errors.h"
+#include "bus.h"
+
+volatile uint8_t busOwned[NBUSES];				// YES while a transfer is under way
+void (* volatile busDeferred[NBUSES])(void);	// Run when the bus is released
+
+/*------------------------------------------------------------------------------
+uint8_t claim_BUS(uint8_t bus)
+	Take a bus for a transfer
+
+	Returns:
+		ERROR if the bus was already owned (a split transfer, such as a
+			RoboClaw read, hasn't been finished)
+		NOERROR otherwise
+------------------------------------------------------------------------------*/
+uint8_t claim_BUS(uint8_t bus)
+{
+
+	uint8_t sreg, owned;
+
+	sreg = SREG;
+	cli();
+	owned = busOwned[bus];
+	busOwned[bus] = YES;
+	SREG = sreg;
+
+	return(owned ? ERROR : NOERROR);
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t defer_BUS(uint8_t bus, void (*work)(void))
+	Called from an interrupt routine that needs a bus. If the bus is owned
+	the work is queued for release_BUS (one job per bus; a newer job
+	replaces an older one) and YES is returned. Otherwise NO is returned and
+	the caller can use the bus right away.
+------------------------------------------------------------------------------*/
+uint8_t defer_BUS(uint8_t bus, void (*work)(void))
+{
+
+	if (busOwned[bus]) {
+		busDeferred[bus] = work;
+		return(YES);
+	}
+	return(NO);
+
+}
+
+/*------------------------------------------------------------------------------
+void release_BUS(uint8_t bus)
+	Give a bus back and run anything an interrupt routine put off while it
+	was owned
+------------------------------------------------------------------------------*/
+void release_BUS(uint8_t bus)
+{
+
+	uint8_t sreg;
+	void (*work)(void);
+
+	sreg = SREG;
+	cli();
+	busOwned[bus] = NO;
+	work = busDeferred[bus];
+	busDeferred[bus] = NULL;
+	SREG = sreg;
+
+	if (work) {
+		work();
+	}
+
+}
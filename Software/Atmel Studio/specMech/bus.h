@@ -0,0 +1,15 @@
+#ifndef BUSH
+#define BUSH
+
+#define BUSTWI			0		// TWI0 (sensors, FRAM, clock, OLEDs, valves)
+#define BUSUSART1		1		// RoboClaw controllers
+#define BUSUSART3		2		// Liquid nitrogen controller
+#define NBUSES			3
+
+extern volatile uint8_t busOwned[NBUSES];
+
+uint8_t claim_BUS(uint8_t);
+uint8_t defer_BUS(uint8_t, void (*)(void));
+void release_BUS(uint8_t);
+
+#endif /* BUSH */
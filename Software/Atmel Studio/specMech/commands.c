@@ -14,36 +14,117 @@
 #include "errors.h"
 #include "testroutine.h"
 #include "commands.h"
+#include "watch.h"
+#include "outbox.h"
+#include "sentences.h"
+#include "bod.h"
 
 uint8_t firstpass;
+uint8_t sessionMode;					// SESSIONINTERACTIVE or SESSIONMACHINE
+uint8_t cmdFailed;						// printError was called by this command
+uint8_t lineFailed, lineSkip;			// A compound line had an error, stopped
+uint32_t cmdWait;						// This command's time in pcmd (ms)
+uint32_t cmdCount, cmdExpired, cmdWaitMax;	// For report_QUEUE
+volatile uint8_t pcmdhead, pcmdtail;	// pcmd ring indices (parse_cmd fills head)
+volatile uint8_t pcmdlost;				// Lines dropped because pcmd was full
 
 /*------------------------------------------------------------------------------
 void commands(void)
-	Command loop
+	Command loop. Runs the oldest command in the pcmd stack. The command was
+	already split into its parts by parse_cmd as the characters arrived.
+
+	The commands on a compound line run one at a time, in order, and only
+	the last one sends the prompt. In a machine session the prompt is ? if
+	any of them failed. After a command that failed and is followed by
+	CMDAND (&) the rest of the line is skipped; after CMDOR (|) the line
+	goes on.
+
+	How long each command waited in the stack is measured from when its
+	line ended (see parse_cmd) and a command past its deadline isn't run
+	(see deadline_cmd).
+
+	Nothing is started while powerFail is set. The command stays in the
+	stack for the next pass, after save_POWERFAIL.
 ------------------------------------------------------------------------------*/
 void commands(void)
 {
 
-	char cmdline[BUFSIZE+1];			// BUFSIZE is the size of the ring buffer
-	static uint8_t cstack = 0;		// pcmd index
+	uint8_t cstack;
+	uint32_t ticks;
 
-	get_cmdline(cmdline);
+	if (powerFail) {
+		return;
+	}
+
+	cstack = pcmdtail;
+	cmdFailed = NO;
+	seen_HOST();					// Host is there, replay events if it had left
+
+	if (!rebootACKd(cstack)) {		// Reboot acknowledge failed
+		pcmdtail = (cstack + 1) % CSTACKSIZE;
+		return;
+	}
 
-	if (!rebootACKd(cmdline)) {		// Reboot acknowledge failed
+	if (lineSkip) {					// An earlier command on the line failed
+		end_cmd(cstack);
 		return;
 	}
 
-	if ((cmdline[0] == '\0') || (cmdline[0] == '!')) {		// <CR> or ! alone are not errors
+	if ((pcmd[cstack].clength == 0) || (pcmd[cstack].cstart == '!')) {	// <CR> or ! alone are not errors
 		firstpass = NO;
-		send_GTprompt();
+		end_cmd(cstack);
 		return;
 	}
 
-	echo_cmd(cmdline);
+	ticks = get_RTCTicks() - pcmd[cstack].carrived;	// 1/512 sec
+	cmdWait = ((ticks / 512) * 1000) + (((ticks % 512) * 1000) / 512);
+	if (cmdWait > cmdWaitMax) {
+		cmdWaitMax = cmdWait;
+	}
+	cmdCount++;
+
+	if (sessionMode == SESSIONINTERACTIVE) {
+		echo_cmd(cstack);
+	}
+
+	if (pcmdlost) {
+		pcmdlost = 0;
+		printError(ERR_CMDFULL, "Command stack full, line dropped");
+	}
+
+	switch (pcmd[cstack].cerror) {
+		case NOERROR:
+			break;
+
+		case ERR_CMDLONG:
+			printError(ERR_CMDLONG, "Command too long");
+			break;
+
+		case ERR_CMDCHECKSUM:
+			printError(ERR_CMDCHECKSUM, "Command checksum");
+			break;
+
+		default:
+			printError(ERR_CMDCHAR, "Bad character in command");
+			break;
+	}
+
+	if (pcmd[cstack].cerror != NOERROR) {
+		pcmd[cstack].cverb = '\0';
+	}
 
-	parse_cmd(cmdline, cstack);
+	if ((pcmd[cstack].cverb != '\0') && (deadline_cmd(cstack) == ERROR)) {
+		pcmd[cstack].cverb = '\0';	// Too late, or a bad deadline
+	}
 
 	switch (pcmd[cstack].cverb) {
+		case '\0':				// Rejected by parse_cmd
+			break;
+
+		case 'a':				// acknowledge events
+			ack_OUTBOX(cstack);
+			break;
+
 		case 'c':				// close
 			close_PNEU(cstack);
 			break;
@@ -68,6 +149,10 @@ void commands(void)
 			testroutine();
 			break;
 
+		case 'w':				// watch (report on change)
+			watch(cstack);
+			break;
+
 		case 'R':				// Reboot
 			squelchErrors = YES;
 			if (motorsMoving()) {
@@ -77,6 +162,8 @@ void commands(void)
 			} else {
 				saveFRAM_MOTOREncoders();
 				timerSAVEENCODER = 0;
+				pcmdtail = (cstack + 1) % CSTACKSIZE;
+				lineFailed = lineSkip = NO;
 				send_GTprompt();	// Aidan request
 				_delay_ms(100);		// Avoids finishing the command loop before reboot
 				reboot();
@@ -88,46 +175,167 @@ void commands(void)
 			break;			
 	}
 
-	cstack = (cstack + 1) % CSTACKSIZE;
-	send_GTprompt();
+	end_cmd(cstack);
 
 }
 
 /*------------------------------------------------------------------------------
-void echo_cmd(char *cmdline)
-	Echo the command line back to the user, adding NMEA header and checksum.
+int32_t days_cmd(char *date)
+	Days from 2000-01-01 to a YYYY-MM-DD date (2000-2099, the DS3231's
+	century, where every fourth year is a leap year). The date must already
+	have been checked.
 ------------------------------------------------------------------------------*/
-void echo_cmd(char *cmdline)
+int32_t days_cmd(char *date)
 {
 
-	const char format_CMD[] = "CMD,%s,%s";
-	char currenttime[20], strbuf[BUFSIZE];
+	const uint16_t before[12] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+	int32_t year, month, days;
 
+	year = atol(date) - 2000;
+	month = atol(&date[5]);
+	days = (year * 365) + ((year + 3) / 4) + before[month-1] + atol(&date[8]) - 1;
+	if (((year % 4) == 0) && (month > 2)) {
+		days++;
+	}
+	return(days);
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t deadline_cmd(uint8_t cstack)
+	Check a command's deadline and take it off the value. The deadline is
+	CMDDEADLINE (@) at the end of the value followed by either
+		<sec> - time to live, counted from when the line arrived (cs@2,
+			ma1000@0.5)
+		[YYYY-MM-DDT]hh:mm:ss - controller time (rt), to the second. With
+			the date the full date and time are compared. Without it the
+			deadline is the nearest hh:mm:ss, within 12 hours either way.
+	A command past its deadline gets an EXP sentence with how late it is
+	and how long it waited, then ERR_CMDEXPIRED:
+		EXP,<time>,<late>,ms,<wait>,ms,<ID>
+
+	Returns:
+		ERROR if the command mustn't run, NOERROR otherwise
+------------------------------------------------------------------------------*/
+uint8_t deadline_cmd(uint8_t cstack)
+{
+
+	char *at, *end, *date, currenttime[20], outbuf[BUFSIZE];
+	int32_t late, now, deadline, month;
+	float ttl;
+
+	if ((at = strchr(pcmd[cstack].cvalue, CMDDEADLINE)) == NULL) {
+		return(NOERROR);
+	}
+	*at++ = '\0';						// The value without the deadline
+
+	if (strchr(at, ':') != NULL) {		// Controller time
+		date = NULL;
+		if ((end = strchr(at, 'T')) != NULL) {
+			date = at;
+			at = end + 1;
+			month = atol(&date[5]);
+			if (((end - date) != 10) || (date[4] != '-') || (date[7] != '-') ||
+				(strncmp(date, "20", 2) != 0) || (month < 1) || (month > 12)) {
+				printError(ERR_CMDDEADLINE, "Deadline is <sec> or [YYYY-MM-DDT]hh:mm:ss");
+				return(ERROR);
+			}
+		}
+		if ((strlen(at) != 8) || (at[2] != ':') || (at[5] != ':')) {
+			printError(ERR_CMDDEADLINE, "Deadline is <sec> or [YYYY-MM-DDT]hh:mm:ss");
+			return(ERROR);
+		}
+		if (get_time(currenttime) == ERROR) {
+			return(ERROR);
+		}
+		deadline = (atol(at) * 3600) + (atol(&at[3]) * 60) + atol(&at[6]);
+		now = (atol(&currenttime[11]) * 3600) + (atol(&currenttime[14]) * 60) +
+			atol(&currenttime[17]);
+		late = now - deadline;
+		if (date != NULL) {
+			late += (days_cmd(currenttime) - days_cmd(date)) * 86400;
+			if (late > 2000000) {		// Keep late in ms inside an int32_t
+				late = 2000000;
+			} else if (late < -2000000) {
+				late = -2000000;
+			}
+		} else if (late < -43200) {		// Deadline was just before midnight, yesterday
+			late += 86400;
+		} else if (late > 43200) {		// Deadline is just after midnight, tomorrow
+			late -= 86400;
+		}
+		late *= 1000;
+	} else {							// Time to live
+		ttl = strtod(at, &end);
+		if ((end == at) || (*end != '\0') || (ttl < 0.0) || (ttl > 86400.0)) {
+			printError(ERR_CMDDEADLINE, "Deadline is <sec> or [YYYY-MM-DDT]hh:mm:ss");
+			return(ERROR);
+		}
+		late = (int32_t) cmdWait - (int32_t) (ttl * 1000.0);
+	}
+
+	if (late <= 0) {
+		return(NOERROR);
+	}
+
+	cmdExpired++;
 	get_time(currenttime);
-	sprintf(strbuf, format_CMD, currenttime, cmdline);
+	format_EXP(outbuf, currenttime, late, cmdWait, pcmd[cstack].cid);
+	printLine(outbuf);
+	printError(ERR_CMDEXPIRED, "Command expired");
+	return(ERROR);
+
+}
+
+/*------------------------------------------------------------------------------
+void echo_cmd(uint8_t cstack)
+	Echo the command back to the user, adding NMEA header and checksum. The
+	line is put back together from its parsed parts so what comes back is
+	exactly what specMech understood, along with how long it waited to run.
+		CMD,<time>,<wait>,ms,<command>
+------------------------------------------------------------------------------*/
+void echo_cmd(uint8_t cstack)
+{
+
+	char currenttime[20], strbuf[BUFSIZE], command[CVALUESIZE+CIDSIZE+2];
+
+	command[0] = pcmd[cstack].cverb;
+	command[1] = pcmd[cstack].cobject;
+	strcpy(&command[2], pcmd[cstack].cvalue);
+	if (pcmd[cstack].cid[0] != '\0') {
+		strcat(command, ";");
+		strcat(command, pcmd[cstack].cid);
+	}
+	get_time(currenttime);
+	format_CMD(strbuf, currenttime, cmdWait, command);
 	printLine(strbuf);
 
 }
 
 /*------------------------------------------------------------------------------
-uint8_t get_cmdline(char *cmdline)
-	Copies the USART0 input buffer to the "cmdline" string
+void end_cmd(uint8_t cstack)
+	Finish a command: pop it off the pcmd stack and either carry its status
+	to the next command on a compound line or send the line's prompt.
 ------------------------------------------------------------------------------*/
-void get_cmdline(char *cmdline)
+void end_cmd(uint8_t cstack)
 {
 
-	uint8_t i;
+	pcmdtail = (cstack + 1) % CSTACKSIZE;
 
-	for (i = 0; recv0_buf.length; i++) {
-		cmdline[i] = recv0_buf.data[recv0_buf.tail];
-		recv0_buf.length--;
-		recv0_buf.tail = (recv0_buf.tail + 1) % BUFSIZE;
-		if (cmdline[i] == '\0') {
-			break;
+	if (cmdFailed) {
+		lineFailed = YES;
+		if (pcmd[cstack].clink == CMDAND) {
+			lineSkip = YES;
 		}
 	}
 
-	cmdline[i] = '\0';		// Overflow protection
+	if (pcmd[cstack].clink != '\0') {
+		return;
+	}
+
+	cmdFailed = lineFailed;
+	lineFailed = lineSkip = NO;
+	send_GTprompt();
 
 }
 
@@ -159,68 +367,180 @@ uint8_t isaletter(char c)
 }
 
 /*------------------------------------------------------------------------------
-void parse_cmd(char *ptr, uint8_t n)
-	Breaks up the command line into its components. The components are:
+void parse_cmd(uint8_t c)
+	Breaks up the command line into its components one character at a time.
+	It's called from the USART0 receive interrupt as each character arrives
+	so the command is ready to run as soon as the <CR> lands. The components
+	are:
 		verb - The command verb, a single character.
 		object - The commanded object, a single character.
 		value - The object's new value, a character string.
 		ID - An identifier selected by the user, a character string.
-	These components are in the ParsedCMD structure defined in main.c. The pcmd
-	variable is a ParsedCMD array.
+	These components are in the ParsedCMD structure defined in commands.h.
+	The pcmd variable is a ParsedCMD array used as a ring buffer; parse_cmd
+	fills pcmd[pcmdhead] and commands() runs pcmd[pcmdtail].
+
+	An optional NMEA-style checksum may end the line (e.g. "os;12*4B"). It's
+	the exclusive-or of every character before the '*'. If it's there it has
+	to match.
+
+	A compound line has several commands separated by CMDAND (&) or CMDOR
+	(|), e.g. "cs&cl&cr&rp;42". Each one gets its own pcmd entry, ahead of
+	pcmdhead, and the ID and checksum at the end of the line apply to all of
+	them. They're handed to commands() together when the line ends so none
+	runs before the checksum is checked. All of them are stamped with the
+	RTC ticks when the line ended (carrived) for deadlines and queue waits.
+
+	Problems (value or ID too long, bad checksum, unprintable characters) are
+	saved in cerror and reported when the command comes up. If the stack is
+	full when the line ends the line is dropped and pcmdlost is incremented.
+	Line feeds are ignored.
 ------------------------------------------------------------------------------*/
-void parse_cmd(char *ptr, uint8_t n)
+void parse_cmd(uint8_t c)
 {
 
+	static uint8_t state, n, checksum, chkvalue, nchk, newline = YES;
+	static uint8_t group, full, newgroup;
 	uint8_t i;
+	uint32_t now;
+	ParsedCMD *cmd;
 
-		// Clear the command parts
-	pcmd[n].cverb = '?';
-	pcmd[n].cobject = '?';
-	pcmd[n].cvalue[0] = '\0';
-	pcmd[n].cid[0] = '\0';
+	if (c == '\n') {
+		return;
+	}
 
-		// Find the verb
-	while (!isaletter(*ptr)) {		// the verb is a single letter
-		if (*ptr == '\0') {
-			return;
-		}
-		ptr++;
+	if (newline) {					// Start of a line
+		group = 0;
+		full = NO;
+		checksum = 0;
+		nchk = 0;
 	}
-	pcmd[n].cverb = *ptr++;
 
-		// Find the object
-	while (!isaletter(*ptr)) {		// objects are single letters
-		if (*ptr == '\0') {
-			return;
-		}
-		ptr++;
+	cmd = &pcmd[(pcmdhead + group) % CSTACKSIZE];
+
+	if (newline || newgroup) {		// Clear the command parts
+		cmd->cverb = '?';
+		cmd->cobject = '?';
+		cmd->cvalue[0] = '\0';
+		cmd->cid[0] = '\0';
+		cmd->cstart = c;
+		cmd->clink = '\0';
+		cmd->clength = 0;
+		cmd->cerror = NOERROR;
+		state = CMDVERB;
+		newline = NO;
+		newgroup = NO;
 	}
-	pcmd[n].cobject = *ptr++;
 
-		// Get the value, if there is one
-	for (i = 0; i < CVALUESIZE; i++) {
-		if (*ptr == '\0') {
-			pcmd[n].cvalue[i] = '\0';
-			return;
+	if (c == '\r') {				// End of the line
+		now = get_RTCTicks();
+		for (i = 0; i < group; i++) {	// Share the ID and checksum result
+			strcpy(pcmd[(pcmdhead + i) % CSTACKSIZE].cid, cmd->cid);
+			pcmd[(pcmdhead + i) % CSTACKSIZE].carrived = now;
 		}
-		if (*ptr == ';') {			// Command ID separator
-			pcmd[n].cvalue[i] = '\0';
-			break;
+		cmd->carrived = now;
+		if ((state == CMDCHECKSUM) && ((nchk != 2) || (chkvalue != checksum))) {
+			for (i = 0; i <= group; i++) {
+				pcmd[(pcmdhead + i) % CSTACKSIZE].cerror = ERR_CMDCHECKSUM;
+			}
+			count_LINK(LNKXPORT, LNKCRC);
+		}
+		if (!full && (((pcmdhead + group + 1) % CSTACKSIZE) != pcmdtail)) {
+			pcmdhead = (pcmdhead + group + 1) % CSTACKSIZE;
+		} else {
+			pcmdlost++;
+			count_LINK(LNKXPORT, LNKDROPPED);
 		}
-		pcmd[n].cvalue[i] = *ptr++;
+		newline = YES;
+		return;
+	}
+
+	if (cmd->clength < 255) {
+		cmd->clength++;
+	}
+
+	if ((c < ' ') || (c > '~')) {	// Reject unprintable characters early
+		cmd->cerror = ERR_CMDCHAR;
+		return;
+	}
+
+	if ((c == '*') && (state != CMDCHECKSUM)) {
+		state = CMDCHECKSUM;
+		chkvalue = 0;
+		return;
 	}
 
-		// get the optional command ID if there is one
-	ptr++;
-	for (i = 0; i < CIDSIZE; i++) {
-		if (*ptr == '\0') {
-			pcmd[n].cid[i] = '\0';
-			return;
+	if (state != CMDCHECKSUM) {
+		checksum ^= c;
+	}
+
+	if (((c == CMDAND) || (c == CMDOR)) && (state < CMDID)) {
+		cmd->clink = c;				// Another command follows
+		if (((pcmdhead + group + 1) % CSTACKSIZE) != pcmdtail) {
+			group++;
+		} else {
+			full = YES;				// Keep parsing, the line is dropped
 		}
-		pcmd[n].cid[i] = *ptr++;
-	}	
+		newgroup = YES;
+		return;
+	}
+
+	switch (state) {
+		case CMDVERB:				// the verb is a single letter
+			if (isaletter(c)) {
+				cmd->cverb = c;
+				state = CMDOBJECT;
+			}
+			break;
 
-	return;
+		case CMDOBJECT:				// objects are single letters
+			if (isaletter(c)) {
+				cmd->cobject = c;
+				state = CMDVALUE;
+				n = 0;
+			}
+			break;
+
+		case CMDVALUE:				// Get the value, if there is one
+			if (c == ';') {			// Command ID separator
+				state = CMDID;
+				n = 0;
+			} else if (n < (CVALUESIZE-1)) {
+				cmd->cvalue[n++] = c;
+				cmd->cvalue[n] = '\0';
+			} else {
+				cmd->cerror = ERR_CMDLONG;
+			}
+			break;
+
+		case CMDID:					// get the optional command ID
+			if (n < (CIDSIZE-1)) {
+				cmd->cid[n++] = c;
+				cmd->cid[n] = '\0';
+			} else {
+				cmd->cerror = ERR_CMDLONG;
+			}
+			break;
+
+		case CMDCHECKSUM:			// Two hex digits
+			chkvalue <<= 4;
+			if ((c >= '0') && (c <= '9')) {
+				chkvalue |= (c - '0');
+			} else if ((c >= 'A') && (c <= 'F')) {
+				chkvalue |= (c - 'A' + 10);
+			} else if ((c >= 'a') && (c <= 'f')) {
+				chkvalue |= (c - 'a' + 10);
+			} else {
+				nchk = 0xFF;		// Not hex, fails the check
+			}
+			if (nchk < 0xFF) {
+				nchk++;
+			}
+			break;
+
+		default:
+			break;
+	}
 
 }
 
@@ -246,6 +566,9 @@ void printLine(char *str)
 		been run and the system has received a reboot acknowledge (the !). This
 		is done to prevent unsolicited text being sent (error messages) at
 		initialization or after a reboot.
+
+		The line goes on the txClass output queue, TXCONTROL unless
+		printEvent has set it.
 ------------------------------------------------------------------------------*/
 void printLine(char *str)
 {
@@ -259,37 +582,41 @@ void printLine(char *str)
 
 	sprintf(strbuf, prFormat, get_SPECID, str);
 	checksum_NMEA(strbuf);
-	send_USART(0, (uint8_t*) strbuf, strlen(strbuf));
+	queue_USART0(txClass, (uint8_t*) strbuf, strlen(strbuf));
 
 }
 
 /*------------------------------------------------------------------------------
-uint8_t rebootACKd(char *cmdline)
+uint8_t rebootACKd(uint8_t cstack)
 	Checks to see if a processor reboot has been acknowledged with a "!\r"
-	command string.
+	command string. Until it has, every line is turned away with a single
+	! (sent for the line's last command, so cs&cl&cr gets one ! too).
 
 	Input:
-		cmdline - the command line string from USART0
+		cstack - the pcmd entry holding the command line from USART0
 
 	Returns:
 		YES if the reboot acknowledge string was received
 		NO if it wasn't
 ------------------------------------------------------------------------------*/
-uint8_t rebootACKd(char *cmdline)
+uint8_t rebootACKd(uint8_t cstack)
 {
 
 
 	if (!rebootackd) {
-		if ((cmdline[0] == '!') && (cmdline[1] == '\0')) {
+		if ((pcmd[cstack].cstart == '!') && (pcmd[cstack].clength == 1)) {
 			init_RTC(511);		// 1-sec RTC clock ticks
 			timeoutOLED = 5;	// 5-sec display timeout (minimum)
+			sessionMode = SESSIONINTERACTIVE;	// New session
 			rebootackd = YES;
 			return(YES);
-		} else if ((cmdline[0] == '!') && (cmdline[1] != '\0')) {
+		} else if ((pcmd[cstack].cstart == '!') && (pcmd[cstack].clength > 1)) {
 			reboot();
 			return(NO);
 		} else {
-			send_EXprompt();
+			if (pcmd[cstack].clink == '\0') {	// Once for the whole line
+				send_EXprompt();
+			}
 //			send_prompt('!');
 			return(NO);
 		}
@@ -299,6 +626,26 @@ uint8_t rebootACKd(char *cmdline)
 
 }
 
+/*------------------------------------------------------------------------------
+uint8_t report_QUEUE(uint8_t cstack)
+	Report how long commands have waited in the pcmd stack (the rq command)
+		QUE,<time>,<commands>,<expired>,<last wait>,ms,<longest wait>,ms,<ID>
+	The counts are since power-up.
+------------------------------------------------------------------------------*/
+uint8_t report_QUEUE(uint8_t cstack)
+{
+
+	char outbuf[BUFSIZE], currenttime[20];
+
+	get_time(currenttime);
+	format_QUE(outbuf, currenttime, cmdCount, cmdExpired, cmdWait, cmdWaitMax,
+		pcmd[cstack].cid);
+	printLine(outbuf);
+
+	return(NOERROR);
+
+}
+
 void send_EXprompt(void)
 {
 
@@ -308,12 +655,21 @@ void send_EXprompt(void)
 
 }
 
+/*------------------------------------------------------------------------------
+void send_GTprompt(void)
+	The end-of-command prompt. In a machine session it's also the command's
+	status: > if it worked, ? if it printed an error.
+------------------------------------------------------------------------------*/
 void send_GTprompt(void)
 {
 
-	const char str[] = ">";
+	const char str[] = ">", strFailed[] = "?";
 
-	send_USART(0, (uint8_t*) str, 1);
+	if ((sessionMode == SESSIONMACHINE) && cmdFailed) {
+		send_USART(0, (uint8_t*) strFailed, 1);
+	} else {
+		send_USART(0, (uint8_t*) str, 1);
+	}
 
 }
 
@@ -5,27 +5,54 @@
 #define CIDSIZE			9	// Maximum length of a command ID string
 #define CSTACKSIZE		10	// Number of stacked up commands allowed
 
+// parse_cmd tokenizer states
+#define CMDVERB			0	// Looking for the verb
+#define CMDOBJECT		1	// Looking for the object
+#define CMDVALUE		2	// Collecting the value
+#define CMDID			3	// Collecting the command ID
+#define CMDCHECKSUM		4	// Collecting the optional *hh checksum
+
+// Compound line separators (e.g. "cs&cl&cr&rp;42")
+#define CMDAND			'&'	// Run the next command only if this one worked
+#define CMDOR			'|'	// Run the next command either way
+#define CMDDEADLINE		'@'	// Deadline at the end of a value (cs@2, cs@12:00:05)
+
+// Session profiles (ss command)
+#define SESSIONINTERACTIVE	0	// Echo, OLED mirroring, > prompt, error text
+#define SESSIONMACHINE		1	// No echo or OLED, > or ? status, error codes only
+
 typedef struct {
 	char cverb,				// Single character command
 	cobject,			// Single character object
 	cvalue[CVALUESIZE],	// Input value string for object
-	cid[CIDSIZE];		// Command ID string
+	cid[CIDSIZE],		// Command ID string (shared by a compound line)
+	cstart,				// First character on the line
+	clink;				// CMDAND or CMDOR if another command follows, '\0' if last
+	uint8_t clength;	// Number of characters on the line
+	uint16_t cerror;	// Error found while parsing (NOERROR if none)
+	uint32_t carrived;	// RTC ticks when the line ended
 } ParsedCMD;
 extern ParsedCMD pcmd[CSTACKSIZE];	// Split the command line into its parts (see main.c)
+extern volatile uint8_t pcmdhead, pcmdtail, pcmdlost;
 
 extern uint8_t firstpass;
+extern uint8_t sessionMode, cmdFailed;
+extern uint32_t cmdWait;
 
 void commands(void);
-void echo_cmd(char*);
-void get_cmdline(char*);
+int32_t days_cmd(char*);
+uint8_t deadline_cmd(uint8_t);
+void echo_cmd(uint8_t);
+void end_cmd(uint8_t);
 uint8_t isadigit(char);
 uint8_t isaletter(char);
-void parse_cmd(char*, uint8_t);
+void parse_cmd(uint8_t);
 void printLine(char*);
-uint8_t rebootACKd(char*);
+uint8_t rebootACKd(uint8_t);
+uint8_t report_QUEUE(uint8_t);
 void send_EXprompt(void);
 void send_GTprompt(void);
 void send_prompt(char);
 void send_sprompt(char*);
 
-#endif
\ No newline at end of file
+#endif
@@ -4,21 +4,24 @@
 #include "commands.h"
 #include "nmea.h"
 #include "errors.h"
+#include "sentences.h"
 
 volatile uint8_t squelchErrors;
 
 /*------------------------------------------------------------------------------
 void printError(uint8_t errorNumber, char *errorString)
-	Prints an error report on USART0
+	Prints an error report on USART0. A machine session gets the error
+	number only.
 ------------------------------------------------------------------------------*/
 void printError(uint16_t errorNumber, char *errorString)
 {
 
 	char strbuf[BUFSIZE];
-	const char errorFormat[] = "ERR,%d,%s";
 
 	if (!squelchErrors) {
-		sprintf(strbuf, errorFormat, errorNumber, errorString);
+		cmdFailed = YES;
+		format_ERR(strbuf, errorNumber,
+			(sessionMode == SESSIONMACHINE) ? NULL : errorString);
 		printLine(strbuf);
 	}
 
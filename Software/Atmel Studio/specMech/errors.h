@@ -8,6 +8,13 @@
 
 #define ERR_BADCOMMAND	(201)	// Command not recognized
 #define ERR_BADOBJECT	(202)	// Object not recognized
+#define ERR_CMDLONG		(203)	// Command value or ID too long
+#define ERR_CMDCHECKSUM	(204)	// Command line *hh checksum doesn't match
+#define ERR_CMDFULL		(205)	// Command stack full, a line was dropped
+#define ERR_CMDCHAR		(206)	// Unprintable character in command line
+#define ERR_BADFIELD	(207)	// Report field letter not recognized
+#define ERR_CMDEXPIRED	(208)	// Command's deadline passed before it ran
+#define ERR_CMDDEADLINE	(209)	// Command deadline isn't <sec> or [YYYY-MM-DDT]hh:mm:ss
 
 #define ERR_UNKNOWNMTR	(301)	// Motor not a, b, c, A, B, or C
 #define ERR_MOVEREL		(302)	// Relative move, collimator motor
@@ -17,6 +24,8 @@
 #define ERR_MTRSETENC	(306)	// Error setting encoder value at initialization
 #define ERR_MTRNULLMOVE	(307)	// No distance or target position specified
 #define ERR_MOTORMOVING	(308)	// Motor is moving (can't reboot)
+#define ERR_MTRPROFILE	(309)	// Unknown motion profile (n, f, s, or a)
+#define ERR_MTRWAYPOINTS	(310)	// More than WPTMAX waypoints in a move
 
 #define ERR_TWI			(401)	// start_TWI NACK
 #define ERR_MCP23008	(402)	// MCP23008 fail to respond to start condition
@@ -24,6 +33,25 @@
 #define ERR_PNUMECH		(501)	// Not a valid mechanism (s, l, r, or b)
 #define ERR_SET			(601)	// Bad object to set
 #define ERR_SETTIME		(602)	// Invalid time format
+#define ERR_SETVALUE	(603)	// Bad value for the set object
+
+#define ERR_WATCH		(701)	// Object can't be watched
+#define ERR_WATCHFULL	(702)	// All watch slots in use
+#define ERR_WATCHVALUE	(703)	// Bad deadband, interval, or heartbeat
+
+#define ERR_SNAPNONE	(801)	// No snapshot matches the request
+#define ERR_SNAPFRAM	(802)	// FRAM error reading or writing a snapshot
+
+#define ERR_TRJBUSY		(901)	// Trajectory dump requested while recording
+#define ERR_TRJFRAM		(902)	// FRAM error reading the trajectory
+#define ERR_TRJNONE		(903)	// No trajectory has been recorded
+
+#define ERR_OUTBOXSEQ	(1001)	// Acknowledged an event that isn't outstanding
+
+#define ERR_BUSOWNED	(1101)	// Bus still owned by an unfinished transfer
+
+#define ERR_ALARMVALUE	(1201)	// Bad alarm limit
+#define ERR_ALARMTWI	(1202)	// Sensor didn't take the alarm limit
 
 extern volatile uint8_t squelchErrors;
 
@@ -8,6 +8,15 @@
 #define ENCAFRAMADDR	(20)	// Motor A encoder value (4 bytes)
 #define ENCBFRAMADDR	(24)	// Motor B encoder value (4 bytes)
 #define ENCCFRAMADDR	(28)	// Motor C encoder value (4 bytes)
+#define VALVEFRAMADDR	(32)	// Commanded valve pattern at the last power fail, and its complement (2 bytes)
+#define OUTBOXSEQADDR	(34)	// Next event sequence number (2 bytes)
+#define OUTBOXACKADDR	(36)	// Last event acknowledged by the host (2 bytes)
+#define ENCSEQADDR		(38)	// Encoder save count, 0 if never saved (2 bytes)
+#define AXISFRAMADDR	(40)	// Encoder values for axes past c (4 bytes each, up to 256)
+#define SNAPFRAMADDR	(256)	// Exposure snapshots (SNAPSLOTS * sizeof(Snapshot))
+#define TRJFRAMADDR		(2048)	// Move trajectory (TRJFRAMSAMPLES * sizeof(TrjSample))
+#define OUTBOXFRAMADDR	(20480)	// Event outbox (OUTBOXSLOTS * OUTBOXSIZE)
+#define USEFRAMADDR		(28672)	// Usage counters (sizeof(Usage))
 
 uint8_t get_SETTIME(char *lastsettime);
 uint8_t read_FRAM(uint8_t, uint16_t, uint8_t *, uint8_t);
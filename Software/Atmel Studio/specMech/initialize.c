@@ -13,6 +13,13 @@
 #include "oled.h"			// Newhaven NHD-0216AW-1B3 display
 #include "roboclaw.h"		// Collimator motor controller
 #include "xport.h"			// Lantronix XPort
+#include "watch.h"			// Report-on-change
+#include "snapshot.h"		// Exposure snapshots
+#include "bod.h"				// Power-fail warning
+#include "outbox.h"			// Event store-and-forward
+#include "wdt.h"			// Task watchdog
+#include "alarm.h"			// Sensor limit alarms
+#include "usage.h"			// Lifetime usage counters
 #include "initialize.h"
 
 uint8_t rebootackd;
@@ -34,6 +41,9 @@ void initialize0(void)
 	init_TWI();			// Sets up the device and its baud rate
 	init_RTC(32);		// 32=Fast, 1/16 sec, for blinking LED at startup
 	init_USART();		// Sets up the devices and global I/O buffers
+	init_WATCH();		// Nothing watched at startup
+	init_BOD();			// Power-fail interrupt
+	init_WDT();			// Last, the RTC interrupt feeds it
 
 }
 
@@ -51,7 +61,11 @@ void initialize1(void)
 	rebootackd = NO;
 //	init_MOTORS();
 	init_MMA8451();					// Accelerometer TWI has a timeout
+	init_ALARM();					// Limits into the MCP9808 and MMA8451
 	init_PNEU();					// GMR sensors through an MCP23008
+	init_SNAPSHOT();				// Needs the GMR sensors and FRAM
+	init_OUTBOX();					// Event sequence numbers from FRAM
+	init_USAGE();					// Usage counters from FRAM
 	init_EEPROM();					// Needs TWI b/c it reads the DS3231 clock
 	init_OLED(0);					// OLED TWI display has a timeout
 	init_OLED(1);					// OLED TWI display has a timeout
@@ -11,6 +11,17 @@ specMech.c
 #include "roboclaw.h"
 #include "oled.h"
 #include "commands.h"
+#include "watch.h"
+#include "snapshot.h"
+#include "trajectory.h"
+#include "waypoint.h"
+#include "bod.h"
+#include "outbox.h"
+#include "wdt.h"
+#include "pneu.h"
+#include "bus.h"
+#include "alarm.h"
+#include "usage.h"
 
 ParsedCMD pcmd[CSTACKSIZE];	// Split the command line into its parts
 
@@ -23,25 +34,102 @@ int main(void)
 	squelchErrors = YES;
 	initialize0();
 	sei();
+	begin_TASK(TSKINIT);
 	initialize1();
+	end_TASK();
 	squelchErrors = NO;
 
 	for (;;) {
-		if (recv0_buf.done) {
-			recv0_buf.done = NO;
+		if (powerFail) {				// Supply is dropping, save state now
+			squelchErrors = YES;
+			begin_TASK(TSKPOWERFAIL);
+			save_POWERFAIL();
+			end_TASK();
+			squelchErrors = NO;
+		}
+		if (busOwned[BUSTWI]) {			// Left owned by a failed transfer,
+			squelchErrors = YES;		// run what was deferred
+			begin_TASK(TSKBUS);
+			release_BUS(BUSTWI);
+			end_TASK();
+			squelchErrors = NO;
+		}
+		if (pcmdhead != pcmdtail) {		// parse_cmd has a command ready
+			begin_TASK(TSKCOMMANDS);
 			commands();
+			end_TASK();
+		}
+		if (powerFail) {				// A wait gave way, save before anything else
+			continue;
+		}
+		if (outboxReplay && rebootackd && (pcmdhead == pcmdtail)) {
+			squelchErrors = YES;
+			begin_TASK(TSKREPLAY);
+			replay_OUTBOX();			// Host is back, resend the backlog
+			end_TASK();
+			squelchErrors = NO;
 		}
 		if (timerOLED > timeoutOLED) {	// Display timeout
 			squelchErrors = YES;
+			begin_TASK(TSKOLED);
 			clear_OLED(0);
 			clear_OLED(1);
+			end_TASK();
 			timerOLED = 0;
 			squelchErrors = NO;
 		} if ((timerSAVEENCODER > timeoutSAVEENCODER) && rebootackd) {
 			squelchErrors = YES;
+			begin_TASK(TSKENCODERS);
 			saveFRAM_MOTOREncoders();
+			save_USAGE();				// Batched usage counts
+			end_TASK();
 			timerSAVEENCODER = 0;
 			squelchErrors = NO;
+		} if (trjRecording) {			// Sample the moving motor
+			squelchErrors = YES;
+			begin_TASK(TSKTRAJECTORY);
+			sample_TRAJECTORY();
+			end_TASK();
+			squelchErrors = NO;
+		} if (trjDumping) {				// Next rj frame, if there's room
+			squelchErrors = YES;
+			begin_TASK(TSKTRAJECTORY);
+			dump_TRAJECTORY();
+			end_TASK();
+			squelchErrors = NO;
+		} if (rebootackd) {				// Report finished waypoints
+			squelchErrors = YES;
+			begin_TASK(TSKWAYPOINTS);
+			check_WAYPOINTS();
+			end_TASK();
+			squelchErrors = NO;
+		} if (pneuChanged && rebootackd) {	// GMR sensors changed
+			squelchErrors = YES;
+			pneuChanged = NO;
+			begin_TASK(TSKSNAPSHOT);
+			check_USEVALVES();			// Time finished transits
+			check_PNEUHOLD();			// Release or re-assert valve coils
+			check_SNAPSHOT();
+			end_TASK();
+			squelchErrors = NO;
+		} if (timerWATCH && rebootackd) {	// Each object on its own interval
+			squelchErrors = YES;
+			begin_TASK(TSKWATCH);
+			check_WATCH();
+			end_TASK();
+			squelchErrors = NO;
+		} if ((alarmTemp || (timerALARM >= ALMPOLL)) && rebootackd) {
+			squelchErrors = YES;		// Sensor limit alarms
+			begin_TASK(TSKALARM);
+			check_ALARM();
+			end_TASK();
+			squelchErrors = NO;
+		} if (wdtPending && rebootackd) {	// Last reset was a task overrun
+			squelchErrors = YES;
+			begin_TASK(TSKWDTREPORT);
+			report_WDT();
+			end_TASK();
+			squelchErrors = NO;
 		}
 	}
 }
@@ -4,10 +4,9 @@ mcp9808.c
 
 	This sensor is soldered onto the specMech board and has high accuracy.
 	
-	The only thing we do is read the ambient temperature register. We leave
-	the other registers at their power-up defaults. Most of the other
-	registers deal with trip points and alarms. The resolution register
-	defaults to the highest resolution of 0.0625 C in the lowest bit.
+	We read the ambient temperature register and set the trip points for
+	the ALERT output (see alarm.c). The resolution register is left at its
+	default, the highest resolution of 0.0625 C in the lowest bit.
 
 	Conversion time is 250 ms (4 Hz) at that resolution so the first read
 	should wait for that amount of time.
@@ -20,6 +19,36 @@ mcp9808.c
 #include "mcp9808.h"
 #include "twi.h"
 
+/*------------------------------------------------------------------------------
+uint8_t alert_MCP9808(float low, float high)
+	Set the ALERT window. In comparator mode ALERT is held low while the
+	temperature is below low or above high (T_CRIT is set to high too) and
+	released once it's back inside by the 1.5 C hysteresis.
+
+	Limits are 13-bit two's complement in 0.0625 C units with the bottom two
+	bits zero (0.25 C steps).
+------------------------------------------------------------------------------*/
+uint8_t alert_MCP9808(float low, float high)
+{
+
+	uint16_t lowlimit, highlimit;
+
+	lowlimit = ((int16_t) (low * 16.0)) & 0x1FFC;
+	highlimit = ((int16_t) (high * 16.0)) & 0x1FFC;
+
+	if (write_MCP9808(MCP9808TLOWER, lowlimit) == ERROR) {
+		return(ERROR);
+	}
+	if (write_MCP9808(MCP9808TUPPER, highlimit) == ERROR) {
+		return(ERROR);
+	}
+	if (write_MCP9808(MCP9808TCRIT, highlimit) == ERROR) {
+		return(ERROR);
+	}
+	return(write_MCP9808(MCP9808CONFIG, MCP9808ALERTON));
+
+}
+
 uint8_t read_MCP9808(float *temperature)
 {
 
@@ -45,3 +74,24 @@ uint8_t read_MCP9808(float *temperature)
 	*temperature = temp;
 	return(NOERROR);
 }
+
+/*------------------------------------------------------------------------------
+uint8_t write_MCP9808(uint8_t reg, uint16_t value)
+	Write a 16-bit MCP9808 register, high byte first
+------------------------------------------------------------------------------*/
+uint8_t write_MCP9808(uint8_t reg, uint16_t value)
+{
+
+	if (start_TWI(MCP9808ADDR, TWIWRITE) == ERROR) {
+		stop_TWI();
+		return(ERROR);
+	}
+	if ((write_TWI(reg) == ERROR) || (write_TWI(value >> 8) == ERROR) ||
+		(write_TWI(value & 0xFF) == ERROR)) {
+		stop_TWI();
+		return(ERROR);
+	}
+	stop_TWI();
+	return(NOERROR);
+
+}
@@ -3,7 +3,14 @@
 
 #define MCP9808ADDR		(0x18)	// TWI address
 #define TEMPREGISTER	(0x05)	// Ambient temperature register
+#define MCP9808CONFIG	(0x01)	// Configuration register
+#define MCP9808TUPPER	(0x02)	// Alert window upper limit
+#define MCP9808TLOWER	(0x03)	// Alert window lower limit
+#define MCP9808TCRIT	(0x04)	// Critical limit (also trips ALERT)
+#define MCP9808ALERTON	(0x0208)	// 1.5 C hysteresis, comparator, active low, alert on
 
+uint8_t alert_MCP9808(float, float);
 uint8_t read_MCP9808(float*);
+uint8_t write_MCP9808(uint8_t, uint16_t);
 
 #endif
\ No newline at end of file
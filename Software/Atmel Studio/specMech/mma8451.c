@@ -1,7 +1,7 @@
 /*------------------------------------------------------------------------------
 mma8451.c
 	MMA8451 accelerometer on an Adafruit breakout board. This is set up to run
-	at +/-2g range, 14 bit resolution, 1.56 Hz sample rate.
+	at +/-2g range, 14 bit resolution, 12.5 Hz sample rate.
 ------------------------------------------------------------------------------*/
 
 #include "globals.h"
@@ -53,9 +53,12 @@ uint8_t init_MMA8451(void)
 	Initialize accelerometer.
 
 	Since we need information only while tracking, we set up for a slow
-	sampling frequency (1.56 Hz), a low cutoff frequency on the high pass
+	sampling frequency (12.5 Hz), a low cutoff frequency on the high pass
 	filter (2.0 Hz), and oversampling and resolution. This gives us good
 	consistency (better than 0.5 cm/s/s) at the cost of longer sampling times.
+	High resolution mode oversamples 128 times at 12.5 Hz just as at 1.56
+	Hz, so the faster rate costs nothing in noise and lets the transient
+	detector (see alarm.c) catch short bumps.
 ------------------------------------------------------------------------------*/
 uint8_t init_MMA8451(void)
 {
@@ -75,8 +78,8 @@ uint8_t init_MMA8451(void)
 		// High resolution mode
 	write_MMA8451(addr, MMA8451CTRLREG2, 0b00000010);
 
-		// 1.56 Hz sampling, low noise, set active
-	write_MMA8451(addr, MMA8451CTRLREG1, 0b00111101);
+		// 12.5 Hz sampling, low noise, set active
+	write_MMA8451(addr, MMA8451CTRLREG1, 0b00101101);
 
 	return(retval);
 
@@ -121,6 +124,42 @@ uint8_t read_MMA8451(uint8_t addr, uint8_t reg, uint8_t *val, uint8_t nbytes)
 
 }
 
+/*------------------------------------------------------------------------------
+uint8_t transient_MMA8451(uint8_t threshold)
+	Set up the transient detector. Any high-pass filtered change bigger
+	than threshold on x, y, or z is latched in TRANSIENT_SRC until it's
+	read. The registers can only be written in standby, so the part is
+	stopped and restarted around the writes.
+
+	Input:
+		threshold - 0.063 g units (1-127), 0 turns the detector off
+
+	Returns:
+		ERROR if the MMA8451 doesn't answer, NOERROR otherwise
+------------------------------------------------------------------------------*/
+uint8_t transient_MMA8451(uint8_t threshold)
+{
+
+	uint8_t addr, ctrl;
+
+	addr = MMA8451ADDR;
+	if (read_MMA8451(addr, MMA8451CTRLREG1, &ctrl, 1) == ERROR) {
+		return(ERROR);
+	}
+	write_MMA8451(addr, MMA8451CTRLREG1, ctrl & ~0x01);		// Standby
+
+	if (threshold) {
+		write_MMA8451(addr, MMA8451TRANSTHS, threshold & 0x7F);
+		write_MMA8451(addr, MMA8451TRANSCOUNT, 1);			// One sample over
+		write_MMA8451(addr, MMA8451TRANSCFG, 0b00011110);	// Latch, z, y, x
+	} else {
+		write_MMA8451(addr, MMA8451TRANSCFG, 0);
+	}
+
+	return(write_MMA8451(addr, MMA8451CTRLREG1, ctrl) ? ERROR : NOERROR);
+
+}
+
 /*------------------------------------------------------------------------------
 uint8_t write_MMA8451(uint8_t addr, uint8_t reg, uint8_t val)
 
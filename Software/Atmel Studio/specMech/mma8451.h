@@ -7,10 +7,16 @@
 #define MMA8451HFCUTOFF		(0x0F)	// MMA8451 HP_FILTER_CUTOFF
 #define MMA8451CTRLREG1		(0x2A)	// MMA8451 CTRL_REG1
 #define MMA8451CTRLREG2		(0x2B)	// MMA8451 CTRL_REG2
+#define MMA8451TRANSCFG		(0x1D)	// MMA8451 TRANSIENT_CFG
+#define MMA8451TRANSSRC		(0x1E)	// MMA8451 TRANSIENT_SRC (reading clears the latch)
+#define MMA8451TRANSTHS		(0x1F)	// MMA8451 TRANSIENT_THS
+#define MMA8451TRANSCOUNT	(0x20)	// MMA8451 TRANSIENT_COUNT
+#define MMA8451THSSTEP		(61.78)	// Transient threshold step (0.063 g in cm/s/s)
 
 uint8_t get_orientation(float*, float*, float*);
 uint8_t init_MMA8451(void);
 uint8_t read_MMA8451(uint8_t, uint8_t, uint8_t*, uint8_t);
+uint8_t transient_MMA8451(uint8_t);
 uint8_t write_MMA8451(uint8_t, uint8_t, uint8_t);
 
 #endif
\ No newline at end of file
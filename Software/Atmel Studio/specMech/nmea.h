@@ -2,6 +2,5 @@
 #define NMEAH
 
 void checksum_NMEA(char*);
-void format_ERR(char*);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,197 @@
+/*------------------------------------------------------------------------------
+outbox.c
+	Store-and-forward for unsolicited sentences (watch reports, waypoint
+	completions, alarms). Each one gets a sequence number and is kept in an
+	FRAM ring until the host acknowledges it, so nothing is lost while the
+	XPort connection is down. They're sent as
+		EVT,<seq>,<sentence>
+	The host counts as gone when no command has arrived for OUTBOXWINDOW
+	seconds. Events are then only stored, and the whole unacknowledged
+	backlog is replayed in order after the next command.
+------------------------------------------------------------------------------*/
+
+#include "globals.h"
+#include "errors.h"
+#include "commands.h"
+#include "fram.h"
+#include "usart.h"
+#include "outbox.h"
+
+uint16_t outboxSeq;				// Sequence number for the next event
+uint16_t outboxAck;				// Host has acknowledged everything up to here
+uint16_t timerHOST;				// Seconds since the last command (RTC ticks)
+uint8_t outboxReplay;			// Replay the backlog from the main loop
+
+/*------------------------------------------------------------------------------
+uint8_t ack_OUTBOX(uint8_t cstack)
+	The ae command
+
+	Input:
+		cstack - the pcmd entry. "ae<seq>" acknowledges every event up to
+			and including <seq>; "ae" alone replays everything not yet
+			acknowledged.
+
+	Returns:
+		ERROR for a bad object or a sequence number that hasn't been sent,
+		NOERROR otherwise
+------------------------------------------------------------------------------*/
+uint8_t ack_OUTBOX(uint8_t cstack)
+{
+
+	uint16_t seq;
+	uint8_t tbuf[2];
+
+	if (pcmd[cstack].cobject != 'e') {
+		printError(ERR_BADOBJECT, "ack: only events (ae)");
+		return(ERROR);
+	}
+
+	if (pcmd[cstack].cvalue[0] == '\0') {
+		outboxReplay = YES;
+		return(NOERROR);
+	}
+
+	seq = (uint16_t) atol(pcmd[cstack].cvalue);
+	if (seq == outboxAck) {			// Repeated ack
+		return(NOERROR);
+	}
+	if ((uint16_t) (outboxSeq - 1 - seq) >= (uint16_t) (outboxSeq - 1 - outboxAck)) {
+		printError(ERR_OUTBOXSEQ, "ack: not an outstanding event");
+		return(ERROR);
+	}
+
+	outboxAck = seq;
+	tbuf[0] = (outboxAck >> 8) & 0xFF;
+	tbuf[1] = outboxAck & 0xFF;
+	write_FRAM(FRAMTWIADDR, OUTBOXACKADDR, tbuf, 2);
+
+	return(NOERROR);
+
+}
+
+/*------------------------------------------------------------------------------
+void init_OUTBOX(void)
+	Pick up the sequence numbers where they were before the reboot. Anything
+	not acknowledged is replayed once the host acknowledges the reboot.
+------------------------------------------------------------------------------*/
+void init_OUTBOX(void)
+{
+
+	uint8_t tbuf[4];
+
+	outboxSeq = 1;
+	outboxAck = 0;
+	if (read_FRAM(FRAMTWIADDR, OUTBOXSEQADDR, tbuf, 4) == NOERROR) {
+		outboxSeq = ((uint16_t) tbuf[0] << 8) | tbuf[1];
+		outboxAck = ((uint16_t) tbuf[2] << 8) | tbuf[3];
+	}
+	if (outboxSeq == 0) {
+		outboxSeq = 1;
+	}
+	timerHOST = 0;
+	outboxReplay = (outboxSeq != (uint16_t) (outboxAck + 1));
+
+}
+
+/*------------------------------------------------------------------------------
+void printEvent(char *str)
+	Send an unsolicited sentence through the outbox
+
+	Input:
+		str - the sentence, without the $S header or checksum (like printLine)
+
+	Output:
+		Saves the sentence in FRAM with the next sequence number and sends
+		it as EVT,<seq>,<str> on the TXEVENT queue if the host is there and
+		no replay is waiting.
+		Sentences longer than OUTBOXSIZE-3 are truncated.
+------------------------------------------------------------------------------*/
+void printEvent(char *str)
+{
+
+	char strbuf[BUFSIZE];
+	const char format_EVT[] = "EVT,%u,%s";
+	uint8_t tbuf[2], nbytes;
+	uint16_t seq, memaddr;
+
+	seq = outboxSeq++;
+	if (outboxSeq == 0) {
+		outboxSeq = 1;
+	}
+
+	memaddr = OUTBOXFRAMADDR + ((seq % OUTBOXSLOTS) * OUTBOXSIZE);
+	nbytes = strlen(str);
+	if (nbytes > (OUTBOXSIZE-3)) {
+		nbytes = OUTBOXSIZE-3;
+	}
+	tbuf[0] = (seq >> 8) & 0xFF;
+	tbuf[1] = seq & 0xFF;
+	write_FRAM(FRAMTWIADDR, memaddr, tbuf, 2);
+	write_FRAM(FRAMTWIADDR, memaddr + 2, (uint8_t*) str, nbytes);
+	tbuf[0] = '\0';
+	write_FRAM(FRAMTWIADDR, memaddr + 2 + nbytes, tbuf, 1);
+	tbuf[0] = (outboxSeq >> 8) & 0xFF;
+	tbuf[1] = outboxSeq & 0xFF;
+	write_FRAM(FRAMTWIADDR, OUTBOXSEQADDR, tbuf, 2);
+
+	if ((timerHOST <= OUTBOXWINDOW) && !outboxReplay) {
+		sprintf(strbuf, format_EVT, seq, str);
+		txClass = TXEVENT;
+		printLine(strbuf);
+		txClass = TXCONTROL;
+	}
+
+}
+
+/*------------------------------------------------------------------------------
+void replay_OUTBOX(void)
+	Resend every event the host hasn't acknowledged, oldest first. If more
+	than OUTBOXSLOTS piled up the oldest were overwritten and the host sees
+	a gap in the sequence numbers.
+------------------------------------------------------------------------------*/
+void replay_OUTBOX(void)
+{
+
+	char strbuf[BUFSIZE];
+	const char format_EVT[] = "EVT,%u,%s";
+	uint8_t slot[OUTBOXSIZE];
+	uint16_t seq, first;
+
+	outboxReplay = NO;
+
+	first = outboxAck + 1;
+	if ((uint16_t) (outboxSeq - first) > OUTBOXSLOTS) {
+		first = outboxSeq - OUTBOXSLOTS;
+	}
+
+	for (seq = first; seq != outboxSeq; seq++) {
+		if (read_FRAM(FRAMTWIADDR, OUTBOXFRAMADDR + ((seq % OUTBOXSLOTS) * OUTBOXSIZE),
+			slot, OUTBOXSIZE) == ERROR) {
+			return;
+		}
+		if ((((uint16_t) slot[0] << 8) | slot[1]) != seq) {	// Never written
+			continue;
+		}
+		slot[OUTBOXSIZE-1] = '\0';
+		sprintf(strbuf, format_EVT, seq, (char*) &slot[2]);
+		txClass = TXEVENT;
+		printLine(strbuf);
+		txClass = TXCONTROL;
+	}
+
+}
+
+/*------------------------------------------------------------------------------
+void seen_HOST(void)
+	Called for every command line. If the host had been gone, schedule a
+	replay of the backlog.
+------------------------------------------------------------------------------*/
+void seen_HOST(void)
+{
+
+	if ((timerHOST > OUTBOXWINDOW) && (outboxSeq != (uint16_t) (outboxAck + 1))) {
+		outboxReplay = YES;
+	}
+	timerHOST = 0;
+
+}
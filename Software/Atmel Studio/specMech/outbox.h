@@ -0,0 +1,17 @@
+#ifndef OUTBOXH
+#define OUTBOXH
+
+#define OUTBOXSLOTS		64		// Unacknowledged events kept in FRAM
+#define OUTBOXSIZE		128		// Bytes per event slot (2-byte sequence + sentence)
+#define OUTBOXWINDOW	120		// Host is gone after this long without a command (sec)
+
+extern uint16_t timerHOST;
+extern uint8_t outboxReplay;
+
+uint8_t ack_OUTBOX(uint8_t);
+void init_OUTBOX(void);
+void printEvent(char*);
+void replay_OUTBOX(void);
+void seen_HOST(void);
+
+#endif
@@ -6,14 +6,75 @@ pneu.c
 #include "globals.h"
 #include "errors.h"
 #include "commands.h"
+#include "fram.h"
 #include "mcp23008.h"
 #include "oled.h"
 #include "pneu.h"
+#include "snapshot.h"
+#include "bus.h"
+#include "rtc.h"
+#include "usage.h"
 
 volatile uint8_t pneuState;
+volatile uint32_t pneuStamp;	// RTC ticks when pneuState was captured
+uint8_t pneuValves;				// Commanded valve pattern (hold_PNEU), saved at power fail
+
+// Valve holding, one entry per cylinder in read_PNEUSensors order
+PneuHold pneuHold[PNEUMECHS] = {
+	{'s', SHUTTERBM, SHUTTEROPEN, SHUTTERCLOSE, PNEUENERGIZE, '\0', NO},
+	{'l', LEFTBM, LEFTOPEN, LEFTCLOSE, PNEUENERGIZE, '\0', NO},
+	{'r', RIGHTBM, RIGHTOPEN, RIGHTCLOSE, PNEUENERGIZE, '\0', NO}
+};
+
+void hold_PNEU(uint8_t, char);
 
 //NEED TO FIX ERROR RETURN SITUATION
 
+/*------------------------------------------------------------------------------
+void check_PNEUHOLD(void)
+	Apply the holding policy. Called from the main loop when the GMR sensors
+	change. A cylinder with the release policy has both of its valve coils
+	turned off once its sensor shows the commanded position, and the
+	commanded pattern is put back if the sensor later shows anything else
+	(drift).
+------------------------------------------------------------------------------*/
+void check_PNEUHOLD(void)
+{
+
+	char position[PNEUMECHS], air;
+	uint8_t i;
+	PneuHold *h;
+
+	for (i = 0; i < PNEUMECHS; i++) {
+		if ((pneuHold[i].policy == PNEURELEASE) && pneuHold[i].target) {
+			break;
+		}
+	}
+	if (i == PNEUMECHS) {			// Nothing to do, skip the TWI read
+		return;
+	}
+
+	read_PNEUSensors(&position[0], &position[1], &position[2], &air);
+
+	for (i = 0; i < PNEUMECHS; i++) {
+		h = &pneuHold[i];
+		if ((h->policy != PNEURELEASE) || (h->target == '\0')) {
+			continue;
+		}
+		if (!h->released && (position[i] == h->target)) {
+			if (set_PNEUVALVES(h->bitmap, ~h->bitmap) == NOERROR) {
+				h->released = YES;
+			}
+		} else if (h->released && (position[i] != h->target)) {
+			if (set_PNEUVALVES(h->bitmap, (h->target == 'o') ?
+				h->openPattern : h->closePattern) == NOERROR) {
+				h->released = NO;
+			}
+		}
+	}
+
+}
+
 /*------------------------------------------------------------------------------
 uint8_t close_PNEU(char mech)
 	Close the shutter or Hartmann doors
@@ -41,21 +102,27 @@ uint8_t close_PNEU(uint8_t cstack)
 		case 'b':
 			set_PNEUVALVES(LEFTBM, LEFTCLOSE);
 			set_PNEUVALVES(RIGHTBM, RIGHTCLOSE);
+			hold_PNEU(1, 'c');
+			hold_PNEU(2, 'c');
 			sprintf(outbuf, dformat_CLO, "both");
 			break;
 
 		case 'l':
 			set_PNEUVALVES(LEFTBM, LEFTCLOSE);
+			hold_PNEU(1, 'c');
 			sprintf(outbuf, dformat_CLO, "left");
 			break;
 			
 		case 'r':
 			set_PNEUVALVES(RIGHTBM, RIGHTCLOSE);
+			hold_PNEU(2, 'c');
 			sprintf(outbuf, dformat_CLO, "right");
 			break;
 
 		case 's':										// Close shutter
 			set_PNEUVALVES(SHUTTERBM, SHUTTERCLOSE);
+			hold_PNEU(0, 'c');
+			take_SNAPSHOT('c', 'c', pcmd[cstack].cid);
 			sprintf(outbuf, dformat_CLO, "shutter");
 			break;
 
@@ -67,17 +134,50 @@ uint8_t close_PNEU(uint8_t cstack)
 
 	}
 
-	clear_OLED(1);
-	writestr_OLED(1, outbuf, 1);
+	if (sessionMode == SESSIONINTERACTIVE) {
+		clear_OLED(1);
+		writestr_OLED(1, outbuf, 1);
+	}
 	return(NOERROR);
 
 }
 
+/*------------------------------------------------------------------------------
+void hold_PNEU(uint8_t mech, char target)
+	Record a new commanded position. The coils were just energized by
+	open_PNEU or close_PNEU. If the cylinder is already there (no sensor
+	change is coming) the release policy is applied right away. The
+	transit is timed for the usage counters. pneuValves keeps the commanded
+	pattern with the coils on, even while they're released.
+------------------------------------------------------------------------------*/
+void hold_PNEU(uint8_t mech, char target)
+{
+
+	PneuHold *h;
+
+	h = &pneuHold[mech];
+	count_USEVALVE(mech, target);
+	pneuValves = (pneuValves & ~h->bitmap) |
+		(h->bitmap & ((target == 'o') ? h->openPattern : h->closePattern));
+	h->target = target;
+	h->released = NO;
+	if (h->policy == PNEURELEASE) {
+		check_PNEUHOLD();
+	}
+
+}
+
 /*------------------------------------------------------------------------------
 uint8_t init_PNEU(void)
 	Initializes the MCP23008 port expander connected to the high current
 	driver. The MCP23008 port expander connected to the GMR (pneumatic) sensors
 	is assumed to be in input mode.
+
+	If save_POWERFAIL left a valve pattern in FRAM (VALVEFRAMADDR, checked
+	against its complement), each cylinder it commanded open or closed is
+	driven there again and held, so the shutter and doors come back where
+	they were commanded instead of with every coil off. The record is then
+	cleared so a later reboot without a power fail doesn't use it.
 ------------------------------------------------------------------------------*/
 /*
 uint8_t init_PNEU(void)
@@ -118,6 +218,10 @@ uint8_t init_PNEU(void)
 uint8_t init_PNEU(void)
 {
 
+	char target;
+	uint8_t i, bits, saved[2];
+	PneuHold *h;
+
 	if (write_MCP23008(HIGHCURRENT, IODIR, 0x00) == ERROR) {
 		return(ERROR);
 	}
@@ -143,6 +247,30 @@ uint8_t init_PNEU(void)
 		return(ERROR);
 	}
 	PORTD.PIN7CTRL = PORT_PULLUPEN_bm | PORT_ISC_BOTHEDGES_gc;	// PNEUSENSORS
+
+	pneuValves = 0x00;
+	if ((read_FRAM(FRAMTWIADDR, VALVEFRAMADDR, saved, 2) == ERROR) ||
+		(saved[0] != (uint8_t) ~saved[1])) {
+		return(NOERROR);				// No power fail record
+	}
+	for (i = 0; i < PNEUMECHS; i++) {
+		h = &pneuHold[i];
+		bits = saved[0] & h->bitmap;
+		if (bits == (h->bitmap & h->openPattern)) {
+			target = 'o';
+		} else if (bits == (h->bitmap & h->closePattern)) {
+			target = 'c';
+		} else {
+			continue;					// Never commanded
+		}
+		if (set_PNEUVALVES(h->bitmap, (target == 'o') ?
+			h->openPattern : h->closePattern) == NOERROR) {
+			h->target = target;
+			pneuValves |= bits;
+		}
+	}
+	saved[0] = saved[1] = 0x00;			// Used once
+	write_FRAM(FRAMTWIADDR, VALVEFRAMADDR, saved, 2);
 	return(NOERROR);
 
 }
@@ -175,21 +303,27 @@ uint8_t open_PNEU(uint8_t cstack)
 		case 'b':
 			set_PNEUVALVES(LEFTBM, LEFTOPEN);
 			set_PNEUVALVES(RIGHTBM, RIGHTOPEN);
+			hold_PNEU(1, 'o');
+			hold_PNEU(2, 'o');
 			sprintf(outbuf, dformat_OPE, "both");
 			break;
 
 		case 'l':
 			set_PNEUVALVES(LEFTBM, LEFTOPEN);
+			hold_PNEU(1, 'o');
 			sprintf(outbuf, dformat_OPE, "left");
 			break;
 		
 		case 'r':
 			set_PNEUVALVES(RIGHTBM, RIGHTOPEN);
+			hold_PNEU(2, 'o');
 			sprintf(outbuf, dformat_OPE, "right");
 			break;
 
 		case 's':
 			set_PNEUVALVES(SHUTTERBM, SHUTTEROPEN);
+			hold_PNEU(0, 'o');
+			take_SNAPSHOT('o', 'c', pcmd[cstack].cid);
 			sprintf(outbuf, dformat_OPE, "shutter");
 			break;
 
@@ -201,8 +335,10 @@ uint8_t open_PNEU(uint8_t cstack)
 
 	}
 
-	clear_OLED(1);
-	writestr_OLED(1, outbuf, 1);
+	if (sessionMode == SESSIONINTERACTIVE) {
+		clear_OLED(1);
+		writestr_OLED(1, outbuf, 1);
+	}
 	return(NOERROR);
 
 }
@@ -215,9 +351,24 @@ void read_PNEUSensors(char *shutter, char *left, char *right, char *air)
 void read_PNEUSensors(char *shutter, char *left, char *right, char *air)
 {
 
-	uint8_t sensors, state;
+	uint8_t sensors;
 // CHANGE TO pneuState????
 	sensors = read_MCP23008(PNEUSENSORS, GPIO);	// NEEDS ERRORCHECK
+	decode_PNEUSensors(sensors, shutter, left, right, air);
+
+}
+
+/*------------------------------------------------------------------------------
+void decode_PNEUSensors(uint8_t sensors, char *shutter, char *left,
+	char *right, char *air)
+	Turn an MCP23008 GPIO (or INTCAP) value into positions: o (open),
+	c (closed), t (in transit), or x (both sensors on, a fault)
+------------------------------------------------------------------------------*/
+void decode_PNEUSensors(uint8_t sensors, char *shutter, char *left,
+	char *right, char *air)
+{
+
+	uint8_t state;
 
 	// Shutter
 	state = sensors >> 6;
@@ -266,6 +417,47 @@ void read_PNEUSensors(char *shutter, char *left, char *right, char *air)
 	}
 }
 
+/*------------------------------------------------------------------------------
+uint8_t set_PNEUHOLD(char mech, char policy)
+	Set the valve holding policy for a mechanism (the sh command)
+
+	Input:
+		mech - s (shutter), l (left), r (right), or b (both doors)
+		policy - PNEUENERGIZE or PNEURELEASE
+
+	Returns:
+		ERROR for an unknown mechanism or policy, NOERROR otherwise
+------------------------------------------------------------------------------*/
+uint8_t set_PNEUHOLD(char mech, char policy)
+{
+
+	uint8_t i;
+	PneuHold *h;
+
+	if ((policy != PNEUENERGIZE) && (policy != PNEURELEASE)) {
+		return(ERROR);
+	}
+	if ((mech != 's') && (mech != 'l') && (mech != 'r') && (mech != 'b')) {
+		return(ERROR);
+	}
+
+	for (i = 0; i < PNEUMECHS; i++) {
+		h = &pneuHold[i];
+		if ((h->name != mech) && !((mech == 'b') && (h->name != 's'))) {
+			continue;
+		}
+		h->policy = policy;
+		if ((policy == PNEUENERGIZE) && h->released) {	// Coils back on
+			set_PNEUVALVES(h->bitmap, (h->target == 'o') ?
+				h->openPattern : h->closePattern);
+			h->released = NO;
+		}
+	}
+	check_PNEUHOLD();					// Release anything already there
+	return(NOERROR);
+
+}
+
 /*------------------------------------------------------------------------------
 set_PNEUVALVES.c
 	Set the Clippard valves.
@@ -309,12 +501,29 @@ uint8_t set_PNEUVALVES(uint8_t bitmap, uint8_t action)
 }
 */
 
+/*------------------------------------------------------------------------------
+void read_PNEUState(void)
+	Read the GMR sensor state captured by the MCP23008 interrupt. Run from
+	the PORTD interrupt, or from release_BUS if the interrupt came in the
+	middle of a TWI transfer (INTCAP holds the value until it's read).
+------------------------------------------------------------------------------*/
+void read_PNEUState(void)
+{
+
+	pneuState = read_MCP23008(PNEUSENSORS, INTCAP);
+	pneuStamp = get_RTCTicks();
+	pneuChanged = YES;					// check_SNAPSHOT looks for a shutter move
+
+}
+
 ISR(PORTD_PORT_vect)
 {
 
 	if (PORTD.INTFLAGS & PIN7_bm) {		// Curiosity Nano button
 		PORTD.INTFLAGS = PIN7_bm;		// Clear the interrupt flag
-		pneuState = read_MCP23008(PNEUSENSORS, INTCAP);
+		if (!defer_BUS(BUSTWI, read_PNEUState)) {	// TWI is free
+			read_PNEUState();
+		}
 	}
 
 }
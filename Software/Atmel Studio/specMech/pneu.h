@@ -13,11 +13,32 @@
 #define RIGHTOPEN		(0x6E)	// AND with this pattern to open
 #define RIGHTCLOSE		(0xE6)	// AND with this pattern to close
 
+// Valve holding policies (sh command)
+#define PNEUENERGIZE	'e'		// Keep the coils energized (default)
+#define PNEURELEASE		'r'		// De-energize once the GMR sensors confirm arrival
+#define PNEUMECHS		3		// Shutter, left, right
+
+typedef struct {
+	char name;					// s, l, or r
+	uint8_t bitmap,				// Valve driver bits for this cylinder
+	openPattern,				// set_PNEUVALVES action to open
+	closePattern;				// set_PNEUVALVES action to close
+	char policy,				// PNEUENERGIZE or PNEURELEASE
+	target;						// Commanded position, 'o' or 'c' ('\0' if none)
+	uint8_t released;			// Coils are off and the sensors are being watched
+} PneuHold;
+
+void check_PNEUHOLD(void);
 uint8_t close_PNEU(uint8_t);
+void decode_PNEUSensors(uint8_t, char*, char*, char*, char*);
 uint8_t init_PNEU(void);
 uint8_t open_PNEU(uint8_t);
 void read_PNEUSensors(char*, char*, char*, char*);
+void read_PNEUState(void);
+uint8_t set_PNEUHOLD(char, char);
 uint8_t set_PNEUVALVES(uint8_t, uint8_t);
 extern volatile uint8_t pneuState;
+extern volatile uint32_t pneuStamp;
+extern uint8_t pneuValves;
 
 #endif
\ No newline at end of file
@@ -17,13 +17,20 @@
 #include "eeprom.h"
 #include "errors.h"
 #include "report.h"
+#include "snapshot.h"
+#include "trajectory.h"
+#include "outbox.h"
+#include "usage.h"
+#include "sentences.h"
 
 /*------------------------------------------------------------------------------
-uint8_t report(char *ptr)
+uint8_t report(uint8_t cstack)
 	Report status, including reading sensors
 
 	Input:
-		*ptr - Command line pointer. Incremented to find object to report
+		cstack - the pcmd entry holding the report command. A value after a
+			numeric object picks the fields to read and send, e.g. rap for
+			an axis position only (see select_REPORT).
 
 	Output:
 		Prints NMEA formatted output to the serial port.
@@ -34,153 +41,346 @@ uint8_t report(char *ptr)
 uint8_t report(uint8_t cstack)
 {
 
-	char outbuf[BUFSIZE], version[11];
+	char outbuf[BUFSIZE], version[11], *select;
 	char currenttime[20], lastsettime[20], boottime[20];
-	char shutter, left, right, air;
-	const char format_ENV[] = "ENV,%s,%3.1f,C,%1.0f,%%,%3.1f,C,%1.0f,%%,%3.1f,C,%1.0f,%%,%3.1f,C,%s";
-	const char format_MTR[] = "MTR,%s,%c,%ld,microns,%ld,microns/sec,%d,mA,%s";
-	const char format_MTV[] = "MTV,%s,%c,%3.1f,V,%3.1f,C,%s";
-	const char format_ORI[] = "ORI,%s,%3.1f,%3.1f,%3.1f,%s";
-	const char dformat_ORI[] = "%2.0f %2.0f %2.0f";
-	const char format_PNU[] = "PNU,%s,%c,shutter,%c,left,%c,right,%c,air,%s";
-	const char dformat_PN1[] = "left:%c   right:%c";
-	const char dformat_PN2[] = "shutter:%c  air:%c";
-	const char format_TIM[] = "TIM,%s,%s,set,%s,boot,%s";
-	const char format_VAC[] = "VAC,%s,%5.2f,redvac,%5.2f,bluevac,%s";
-	const char dformat_VAC[] = "%2.2f  %2.2f";
-	const char format_VER[] = "VER,%s,%s,%s";
-	uint8_t retval, controller;
-	int32_t encoderValue, encoderSpeed, micronValue, micronSpeed;
-	uint32_t icurrents;
-	float t0, t1, t2, t3, h0, h1, h2;		// temperature and humidity
-	float voltage;							// voltage
-	uint16_t current;
-	float x, y, z;							// accelerometer
-	float redvac, bluvac;					// red and blue vacuum
+	const char *letters;
+	float fields[REPORTFIELDS];
 
 	switch(pcmd[cstack].cobject) {
 
-		case 'A':
-		case 'B':
-		case 'C':
+		case 't':					// Report current time on specMech clock
 			get_time(currenttime);
-			controller = pcmd[cstack].cobject + 63;
-			retval = get_MOTORFloat(controller, ROBOREADMAINVOLTAGE, &voltage);
-			if (retval == ERROR) {
-				voltage = -666.0;
-			}
-			retval = get_MOTORFloat(controller, ROBOREADTEMPERATURE, &t0);
-			if (retval == ERROR) {
-				t0 = -666.0;
-			}
-			sprintf(outbuf, format_MTV, currenttime, (char) (controller-63),
-				voltage, t0, pcmd[cstack].cid);
+			get_SETTIME(lastsettime);
+//			read_FRAM(FRAMTWIADDR, SETTIMEADDR, (uint8_t*) lastsettime, 20);
+			get_BOOTTIME(boottime);
+			format_TIM(outbuf, currenttime, lastsettime, boottime,
+				pcmd[cstack].cid);
 			printLine(outbuf);
+			if (sessionMode == SESSIONINTERACTIVE) {
+				writestr_OLED(1, "Time", 1);
+				writestr_OLED(1, &currenttime[11], 2);
+			}
 			break;
 
-		case 'a':
-		case 'b':
-		case 'c':
+		case 'j':					// Last recorded move trajectory
+			return(report_TRAJECTORY(cstack));
+
+		case 'x':					// Exposure snapshots
+			return(report_SNAPSHOT(cstack));
+
+		case 'l':					// Link health counters
+			return(report_LINK(cstack));
+
+		case 'q':					// Command queue waits
+			return(report_QUEUE(cstack));
+
+		case 'u':					// Lifetime usage counters
+			return(report_USAGE(cstack));
+
+		case 'V':
+			get_VERSION(version);	// Send the specMech version
 			get_time(currenttime);
-			controller = pcmd[cstack].cobject + 31;
-			retval = get_MOTOREncoder(controller, ROBOREADENCODERCOUNT, &encoderValue);
-			if (retval == ERROR) {
-				encoderValue = 0x7FFFFFFF;
-			}
-			micronValue = encoderValue/ROBOCOUNTSPERMICRON;
-			retval = get_MOTOREncoder(controller, ROBOREADENCODERSPEED, &encoderSpeed);
-			if (retval == ERROR) {
-				encoderSpeed = 0x7FFFFFFF;
-			}
-			micronSpeed = encoderSpeed/ROBOCOUNTSPERMICRON;
-			retval = get_MOTORInt32(controller, ROBOREADCURRENT, &icurrents);
-			if (retval == ERROR) {
-				icurrents = 0x7FFFFFFF;
-			}
-			current = (uint16_t) ((icurrents >> 16) * 10);	// convert to mA
-			sprintf(outbuf, format_MTR, currenttime, pcmd[cstack].cobject,
-				micronValue, micronSpeed, current, pcmd[cstack].cid);
+			format_VER(outbuf, currenttime, version, pcmd[cstack].cid);
 			printLine(outbuf);
+			if (sessionMode == SESSIONINTERACTIVE) {
+				writestr_OLED(1, "specMech Version", 1);
+				writestr_OLED(1, version, 2);
+			}
 			break;
 
-		case 'e':					// Environment (temperature & humidity)
-			t0 = get_temperature(0);
-			h0 = get_humidity(0);
-			t1 = get_temperature(1);
-			h1 = get_humidity(1);
-			t2 = get_temperature(2);
-			h2 = get_humidity(2);
-			t3 = get_temperature(3);
-			get_time(currenttime);
-			sprintf(outbuf, format_ENV, currenttime, t0, h0, t1, h1, t2, h2, t3, pcmd[cstack].cid);
-			printLine(outbuf);
+		default:
+			if ((letters = select_REPORT(pcmd[cstack].cobject)) == NULL) {
+				printError(ERR_BADOBJECT, "report: unknown object");
+				return(ERROR);
+			}
+			select = NULL;			// Every field
+			if (pcmd[cstack].cvalue[0] != '\0') {
+				select = pcmd[cstack].cvalue;
+				if (strspn(select, letters) != strlen(select)) {
+					printError(ERR_BADFIELD, "report: unknown field");
+					return(ERROR);
+				}
+			}
+			get_REPORT(pcmd[cstack].cobject, select, fields);
+			put_REPORT(pcmd[cstack].cobject, select, fields, pcmd[cstack].cid, NO);
+			if (sessionMode == SESSIONINTERACTIVE) {
+				display_REPORT(pcmd[cstack].cobject, fields);
+			}
+			break;
+	}
+
+	return(NOERROR);
+
+}
+
+/*------------------------------------------------------------------------------
+void display_REPORT(char object, float *fields)
+	Mirror a report on the OLED display
+
+	Input:
+		object - the report object (see get_REPORT)
+		fields - the values filled in by get_REPORT
+
+	Output:
+		Writes two lines to OLED 1. Motors aren't displayed.
+------------------------------------------------------------------------------*/
+void display_REPORT(char object, float *fields)
+{
+
+	char outbuf[BUFSIZE];
+	const char dformat_ORI[] = "%2.0f %2.0f %2.0f";
+	const char dformat_PN1[] = "left:%c   right:%c";
+	const char dformat_PN2[] = "shutter:%c  air:%c";
+	const char dformat_VAC[] = "%2.2f  %2.2f";
+
+	switch(object) {
+
+		case 'e':
 			writestr_OLED(1, "Temp & Humidity", 1);
-			sprintf(outbuf, "%1.1fC %1.0fF %1.0f%%", t0, ((t0*1.8)+32), h0);
+			sprintf(outbuf, "%1.1fC %1.0fF %1.0f%%", fields[0],
+				((fields[0]*1.8)+32), fields[1]);
 			writestr_OLED(1, outbuf, 2);
 			break;
 
-		case 'o':					// Orientation
-			get_orientation(&x, &y, &z);
-			get_time(currenttime);
-			sprintf(outbuf, format_ORI, currenttime, x, y, z, pcmd[cstack].cid);
-			printLine(outbuf);
+		case 'o':
 			writestr_OLED(1, "Orientation", 1);
-			sprintf(outbuf, dformat_ORI, x, y, z);
+			sprintf(outbuf, dformat_ORI, fields[0], fields[1], fields[2]);
 			writestr_OLED(1, outbuf, 2);
 			break;
 
 		case 'p':
-			get_time(currenttime);
-			read_PNEUSensors(&shutter, &left, &right, &air);
-			sprintf(outbuf, format_PNU, currenttime, shutter, left, right, air, pcmd[cstack].cid);
-			printLine(outbuf);
-
-			sprintf(outbuf, dformat_PN1, left, right);
+			sprintf(outbuf, dformat_PN1, (char) fields[1], (char) fields[2]);
 			writestr_OLED(1, outbuf, 1);
-			sprintf(outbuf, dformat_PN2, shutter, air);
+			sprintf(outbuf, dformat_PN2, (char) fields[0], (char) fields[3]);
 			writestr_OLED(1, outbuf, 2);
 			break;
 
-		case 't':					// Report current time on specMech clock
-			get_time(currenttime);
-			get_SETTIME(lastsettime);
-//			read_FRAM(FRAMTWIADDR, SETTIMEADDR, (uint8_t*) lastsettime, 20);
-			get_BOOTTIME(boottime);
-			sprintf(outbuf, format_TIM, currenttime, lastsettime,
-				boottime, pcmd[cstack].cid);
-			printLine(outbuf);
-			writestr_OLED(1, "Time", 1);
-			writestr_OLED(1, &currenttime[11], 2);			
+		case 'v':
+			writestr_OLED(1, "RedVac  BlueVac", 1);
+			sprintf(outbuf, dformat_VAC, fields[0], fields[1]);
+			writestr_OLED(1, outbuf, 2);
+			break;
+
+		default:
 			break;
+	}
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t get_REPORT(char object, char *select, float *fields)
+	Read the sensors or motor controller behind a report object
+
+	Input:
+		object - one of the numeric report objects:
+			A, B, C - the axis's motor controller voltage and temperature
+			a, b, c - axis position (microns), speed (microns/sec), current (mA)
+				(any axis in axes[] works the same way)
+			e - temperature & humidity in sentence order (t0,h0,t1,h1,t2,h2,t3)
+			o - orientation x, y, z
+			p - pneumatic shutter, left, right, air (state characters)
+			v - red and blue ion pump vacuum
+		select - NULL for every field, or the letters of the fields wanted
+			(see select_REPORT). Only those are read.
+
+	Output:
+		fields - filled with the values in the order they appear in the
+			full sentence, BADFLOAT for fields not asked for. The array must
+			hold REPORTFIELDS values.
+
+	Returns:
+		The number of fields in the full sentence, 0 if the object is unknown.
+------------------------------------------------------------------------------*/
+uint8_t get_REPORT(char object, char *select, float *fields)
+{
+
+	char shutter, left, right, air;
+	uint8_t i, retval, axis;
+	uint16_t current;
+	int32_t encoderValue, encoderSpeed;
+
+	for (i = 0; i < REPORTFIELDS; i++) {
+		fields[i] = BADFLOAT;
+	}
+
+	switch(object) {
+
+		case 'e':					// Environment (temperature & humidity)
+			for (i = 0; i < 4; i++) {
+				if (SNTWANT(select, 't')) {
+					fields[2*i] = get_temperature(i);
+				}
+				if ((i < 3) && SNTWANT(select, 'h')) {
+					fields[(2*i)+1] = get_humidity(i);
+				}
+			}
+			return(7);
+
+		case 'o':					// Orientation
+			get_orientation(&fields[0], &fields[1], &fields[2]);
+			return(3);
+
+		case 'p':
+			read_PNEUSensors(&shutter, &left, &right, &air);
+			fields[0] = (float) shutter;
+			fields[1] = (float) left;
+			fields[2] = (float) right;
+			fields[3] = (float) air;
+			return(4);
 
 		case 'v':
-			redvac = read_ionpump(REDPUMP);
-			bluvac = read_ionpump(BLUEPUMP);
-			get_time(currenttime);
-			sprintf(outbuf, format_VAC, currenttime, redvac, bluvac, pcmd[cstack].cid);
-			printLine(outbuf);
+			if (SNTWANT(select, 'r')) {
+				fields[0] = read_ionpump(REDPUMP);
+			}
+			if (SNTWANT(select, 'b')) {
+				fields[1] = read_ionpump(BLUEPUMP);
+			}
+			return(2);
 
-			writestr_OLED(1, "RedVac  BlueVac", 1);
-			sprintf(outbuf, dformat_VAC, redvac, bluvac);
-			writestr_OLED(1, outbuf, 2);
+		default:					// Motor axes
+			if ((axis = get_AXIS(object)) == ERROR) {
+				return(0);
+			}
+			if ((object >= 'A') && (object <= 'Z')) {
+				if (SNTWANT(select, 'v')) {
+					retval = get_MOTORFloat(axes[axis].address, ROBOREADMAINVOLTAGE, &fields[0]);
+					if (retval == ERROR) {
+						fields[0] = BADFLOAT;
+					}
+				}
+				if (SNTWANT(select, 't')) {
+					retval = get_MOTORFloat(axes[axis].address, ROBOREADTEMPERATURE, &fields[1]);
+					if (retval == ERROR) {
+						fields[1] = BADFLOAT;
+					}
+				}
+				return(2);
+			}
+			if (SNTWANT(select, 'p')) {		// One RoboClaw trip per field
+				retval = get_MOTOREncoder(axis, ROBOREADENCODERCOUNT, &encoderValue);
+				if (retval == ERROR) {
+					encoderValue = 0x7FFFFFFF;
+				}
+				fields[0] = (float) (encoderValue/(int32_t) axes[axis].countsPerMicron);
+			}
+			if (SNTWANT(select, 's')) {
+				retval = get_MOTOREncoder(axis, ROBOREADENCODERSPEED, &encoderSpeed);
+				if (retval == ERROR) {
+					encoderSpeed = 0x7FFFFFFF;
+				}
+				fields[1] = (float) (encoderSpeed/(int32_t) axes[axis].countsPerMicron);
+			}
+			if (SNTWANT(select, 'c')) {
+				get_MOTORCurrent(axis, &current);
+				fields[2] = (float) ((uint16_t) (current * 10));	// convert to mA
+			}
+			return(3);
+	}
+
+}
+
+/*------------------------------------------------------------------------------
+void put_REPORT(char object, char *select, float *fields, char *cid,
+	uint8_t event)
+	Send a report sentence built from values read by get_REPORT
+
+	Input:
+		object - the report object (see get_REPORT)
+		select - NULL for the full sentence, or the fields wanted. A short
+			sentence's type is marked with them (MTR:p).
+		fields - the values filled in by get_REPORT
+		cid - the command ID to tack on the end (empty for unsolicited reports)
+		event - YES for unsolicited reports, which go through the outbox
+
+	Output:
+		Prints an NMEA formatted sentence to the serial port. The layouts
+		are in Software/Host/sentences.def (see sentences.c).
+------------------------------------------------------------------------------*/
+void put_REPORT(char object, char *select, float *fields, char *cid,
+	uint8_t event)
+{
+
+	char outbuf[BUFSIZE], currenttime[20];
+
+	get_time(currenttime);
+
+	switch(object) {
+
+		case 'e':
+			format_ENV(outbuf, select, currenttime, fields[0], fields[1], fields[2],
+				fields[3], fields[4], fields[5], fields[6], cid);
 			break;
 
-		case 'V':
-			get_VERSION(version);	// Send the specMech version
-			get_time(currenttime);
-			sprintf(outbuf, format_VER, currenttime, version, pcmd[cstack].cid);
-			printLine(outbuf);
-			writestr_OLED(1, "specMech Version", 1);
-			get_VERSION(outbuf);
-			writestr_OLED(1, outbuf, 2);
+		case 'o':
+			format_ORI(outbuf, currenttime, fields[0], fields[1], fields[2], cid);
 			break;
 
-		default:
-			printError(ERR_BADOBJECT, "report: unknown object");
-			return(ERROR);
+		case 'p':
+			format_PNU(outbuf, currenttime, (char) fields[0], (char) fields[1],
+				(char) fields[2], (char) fields[3], cid);
+			break;
+
+		case 'v':
+			format_VAC(outbuf, select, currenttime, fields[0], fields[1], cid);
+			break;
+
+		default:					// Motor axes
+			if (get_AXIS(object) == ERROR) {
+				return;
+			}
+			if ((object >= 'A') && (object <= 'Z')) {
+				format_MTV(outbuf, select, currenttime, object, fields[0],
+					fields[1], cid);
+			} else {
+				format_MTR(outbuf, select, currenttime, object, (int32_t) fields[0],
+					(int32_t) fields[1], (uint16_t) fields[2], cid);
+			}
 			break;
 	}
 
-	return(NOERROR);
+	if (event) {
+		printEvent(outbuf);
+	} else {
+		printLine(outbuf);
+	}
+
+}
+
+/*------------------------------------------------------------------------------
+const char *select_REPORT(char object)
+	The field letters a numeric report object takes (rap, ret, ...)
+		a, b, c - p position, s speed, c current
+		A, B, C - v voltage, t temperature
+		e - t temperatures, h humidities
+		v - r red pump, b blue pump
+	o and p come from one sensor read so they have no short forms.
+
+	Returns:
+		The letters, "" if the object has no short forms, NULL if it isn't
+		a numeric report object
+------------------------------------------------------------------------------*/
+const char *select_REPORT(char object)
+{
+
+	switch(object) {
+		case 'e':
+			return(SNTSELECT_ENV);
+
+		case 'o':
+		case 'p':
+			return("");
+
+		case 'v':
+			return(SNTSELECT_VAC);
+
+		default:
+			if (get_AXIS(object) == ERROR) {
+				return(NULL);
+			}
+			if ((object >= 'A') && (object <= 'Z')) {
+				return(SNTSELECT_MTV);
+			}
+			return(SNTSELECT_MTR);
+	}
 
 }
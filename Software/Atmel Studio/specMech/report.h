@@ -1,6 +1,13 @@
 #ifndef REPORTH
 #define REPORTH
 
+#define REPORTFIELDS	7	// Most numeric fields in a report sentence (ENV)
+#define REPORTOBJECTS	"ejlopqtuvxV"	// Objects report() takes before the axes
+
+void display_REPORT(char, float*);
+uint8_t get_REPORT(char, char*, float*);
+void put_REPORT(char, char*, float*, char*, uint8_t);
 uint8_t report(uint8_t);
+const char *select_REPORT(char);
 
-#endif
\ No newline at end of file
+#endif
@@ -10,8 +10,40 @@ roboclaw.c
 #include "fram.h"
 #include "errors.h"
 #include "roboclaw.h"
+#include "trajectory.h"
+#include "waypoint.h"
+#include "wdt.h"
+#include "rtc.h"
+#include "bus.h"
+#include "usage.h"
+#include "bod.h"
+#include "report.h"
 
 uint8_t timerSAVEENCODER, timeoutSAVEENCODER;
+uint16_t encoderSeq;					// saveFRAM_MOTOREncoders passes (ENCSEQADDR)
+uint8_t roboController, roboCommand;	// The read under way (for its CRC)
+uint32_t roboStart;						// RTC ticks when it was sent
+int32_t lastEncoder[NAXES];				// Last count read from each axis
+uint8_t lastEncoderOK[NAXES];			// lastEncoder has been read since power-up
+
+// The axis registry. Everything that moves, reports, saves, or polls a
+// motor goes through this table. An axis named after a report object
+// (REPORTOBJECTS, either case) is never found by get_AXIS, and i and h are
+// taken by the watch settings (wi, wh). Axes past c save their encoders
+// at AXISFRAMADDR + 4*(index-3), e.g. a second-channel focus stage:
+//	{'d', MOTORAADDR, 2, ROBOCOUNTSPERMICRON, 'n', 8192, 8192, AXISFRAMADDR}
+// No profile moves an axis harder than its acceleration and speed limits.
+const Axis axes[NAXES] = {
+	{'a', MOTORAADDR, 1, ROBOCOUNTSPERMICRON, 'a', FASTACCELERATION, FASTSPEED, ENCAFRAMADDR},
+	{'b', MOTORBADDR, 1, ROBOCOUNTSPERMICRON, 'a', FASTACCELERATION, FASTSPEED, ENCBFRAMADDR},
+	{'c', MOTORCADDR, 1, ROBOCOUNTSPERMICRON, 'a', FASTACCELERATION, FASTSPEED, ENCCFRAMADDR}
+};
+
+const MotionProfile motionProfiles[] = {
+	{'n', ACCELERATION, SPEED, DECELERATION},
+	{'f', FASTACCELERATION, FASTSPEED, FASTDECELERATION},
+	{'s', SLOWACCELERATION, SLOWSPEED, SLOWDECELERATION}
+};
 
 /*------------------------------------------------------------------------------
 uint16_t crc16(uint8_t *packet, uint16_t nbytes)
@@ -27,10 +59,22 @@ uint16_t crc16(uint8_t *packet, uint16_t nbytes)
 		The CRC16 value as an unsigned 16-bit word
 ------------------------------------------------------------------------------*/
 uint16_t crc16(uint8_t *packet, uint16_t nBytes)
+{
+
+	return(crc16_continue(0, packet, nBytes));
+
+}
+
+/*------------------------------------------------------------------------------
+uint16_t crc16_continue(uint16_t crc, uint8_t *packet, uint16_t nBytes)
+
+	Same as crc16 but starts from a running CRC value so a long block can be
+	checked a piece at a time. Start with crc = 0.
+------------------------------------------------------------------------------*/
+uint16_t crc16_continue(uint16_t crc, uint8_t *packet, uint16_t nBytes)
 {
 
 	uint8_t bit;
-	uint16_t crc = 0;
 	int16_t byte;
 
 	for (byte = 0; byte < nBytes; byte++) {
@@ -47,11 +91,148 @@ uint16_t crc16(uint8_t *packet, uint16_t nBytes)
 }
 
 /*------------------------------------------------------------------------------
-uint8_t getFRAM_MOTOREncoder(uint8_t controller, uint32_t *encoderValue)
+uint8_t end_MOTOREncoder(int32_t *value)
+	Finish an encoder read started by start_MOTOREncoder
+
+	Output:
+		value: the encoder count or speed (0 on a CRC error)
+
+	A count is also kept in lastEncoder for the power-fail save, so every
+	read (reports, snapshots, trajectories, waypoints) keeps it current.
+
+	Returns:
+		ERROR on timeout or CRC error
+		NOERROR otherwise
+
+	Also available but not output here:
+		status - from page 86 of version 5.7 of the manual:
+			Bit0: Counter underflow (1=underflow occurred, clear after reading)
+			Bit1: Direction (0=forward, 1-backwards)
+			Bit2: Counter overflow (1=overflow occurred, clear after reading)
+			Bits 3-7 are "reserved." Bit7 is 1.
+------------------------------------------------------------------------------*/
+uint8_t end_MOTOREncoder(int32_t *value)
+{
+
+	uint8_t i, data[5];
+
+	if (end_MOTORRead(data) == ERROR) {
+		*value = 0;
+		return(ERROR);
+	}
+
+	*value =  (uint32_t) data[0] << 24;
+	*value |= (uint32_t) data[1] << 16;
+	*value |= (uint32_t) data[2] << 8;
+	*value |= (uint32_t) data[3];
+
+	for (i = 0; i < NAXES; i++) {
+		if ((axes[i].address == roboController) &&
+			(roboCommand == (ROBOREADENCODERCOUNT + axes[i].channel - 1))) {
+			lastEncoder[i] = *value;
+			lastEncoderOK[i] = YES;
+		}
+	}
+
+//	status = data[4];
+
+	return(NOERROR);
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t end_MOTORRead(uint8_t *data)
+	Wait for the reply to a read started by start_MOTORRead and check its
+	CRC. The reply has been coming in by interrupt since the request went
+	out, so whatever the caller did in between (TWI reads, for instance)
+	overlapped with it. The timeout uses the RTC because TCB0 is used for
+	the TWI timeouts.
+
+	Output:
+		data: the reply without its CRC (nbytes - 2 bytes)
+
+	Returns:
+		ERROR on timeout or CRC error
+		NOERROR otherwise
+------------------------------------------------------------------------------*/
+uint8_t end_MOTORRead(uint8_t *data)
+{
+
+	uint8_t i, nbytes, tbuf[2];
+	uint16_t crcReceived, crcExpected;
+
+	TRACE_WDT(TRCROBOCLAW);
+	while (recv1_buf.done == NO) {	// Wait for the reply
+		if (powerFail) {			// Give way to save_POWERFAIL
+			release_BUS(BUSUSART1);
+			return(ERROR);
+		}
+		if ((get_RTCTicks() - roboStart) > ROBOTIMEOUT) {
+			release_BUS(BUSUSART1);
+			count_LINK(LNKROBOCLAW, LNKTIMEOUT);
+			printError(ERR_MTRTIMEOUT, "RoboClaw read timeout");
+			return(ERROR);
+		}
+	}
+	release_BUS(BUSUSART1);
+
+	nbytes = recv1_buf.nbytes - 2;
+	crcReceived = (recv1_buf.data[nbytes] << 8) | recv1_buf.data[nbytes+1];
+	tbuf[0] = roboController;
+	tbuf[1] = roboCommand;
+	crcExpected = crc16_continue(crc16(tbuf, 2), recv1_buf.data, nbytes);
+	if (crcReceived != crcExpected) {
+		count_LINK(LNKROBOCLAW, LNKCRC);
+		printError(ERR_MTRENCCRC, "RoboClaw read CRC");
+		return(ERROR);
+	}
+
+	for (i = 0; i < nbytes; i++) {
+		data[i] = recv1_buf.data[i];
+	}
+	return(NOERROR);
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t get_AXIS(char object)
+	Find an axis in the registry
+
+	Inputs:
+		object: the axis name, either case (uppercase is used for absolute
+			moves and for reporting the axis's controller)
+
+	Returns:
+		The index into axes[], or ERROR if there's no such axis or its name
+		is a report object (REPORTOBJECTS), which report() would take first
+------------------------------------------------------------------------------*/
+uint8_t get_AXIS(char object)
+{
+
+	uint8_t i;
+
+	if ((object >= 'A') && (object <= 'Z')) {
+		object += 'a' - 'A';
+	}
+	if ((strchr(REPORTOBJECTS, object) != NULL) ||
+		(strchr(REPORTOBJECTS, object - ('a' - 'A')) != NULL)) {
+		return(ERROR);
+	}
+	for (i = 0; i < NAXES; i++) {
+		if (axes[i].name == object) {
+			return(i);
+		}
+	}
+	return(ERROR);
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t getFRAM_MOTOREncoder(uint8_t axis, uint32_t *encoderValue)
 	Retrieves the encoder value stored in FRAM
 
 	Inputs:
-		controller: The controller in question (128, 129, or 130)
+		axis: index into axes[]
 
 	Outputs:
 		encoderValue: The stored encoder value
@@ -60,31 +241,13 @@ uint8_t getFRAM_MOTOREncoder(uint8_t controller, uint32_t *encoderValue)
 		ERROR on FRAM read error
 		NOERROR otherwise
 ------------------------------------------------------------------------------*/
-uint8_t getFRAM_MOTOREncoder(uint8_t controller, int32_t *encoderValue)
+uint8_t getFRAM_MOTOREncoder(uint8_t axis, int32_t *encoderValue)
 {
 
 	uint8_t tbuf[4];
-	uint16_t memaddr;
 	int32_t tempVal;
 
-	switch (controller) {
-		case MOTORAADDR:
-			memaddr = ENCAFRAMADDR;
-			break;
-
-		case MOTORBADDR:
-			memaddr = ENCBFRAMADDR;
-			break;
-
-		case MOTORCADDR:
-			memaddr = ENCCFRAMADDR;
-			break;
-
-		default:
-			return(ERROR);
-	}
-
-	if (read_FRAM(FRAMTWIADDR, memaddr, tbuf, 4) == ERROR) {
+	if (read_FRAM(FRAMTWIADDR, axes[axis].framaddr, tbuf, 4) == ERROR) {
 		return(ERROR);
 	}
 	tempVal =  (uint32_t) tbuf[0] << 24;
@@ -98,73 +261,134 @@ uint8_t getFRAM_MOTOREncoder(uint8_t controller, int32_t *encoderValue)
 }
 
 /*------------------------------------------------------------------------------
-uint8_t get_MOTOREncoder(uint8_t controller, uint8_t command, uint32_t *value)
+uint8_t get_MOTORBuffer(uint8_t controller, uint8_t *depth)
+	Reads the command buffer lengths (command 47) for both channels of a
+	controller in one exchange
+
+	Inputs:
+		controller:	Controller address (128-135)
+
+	Outputs:
+		depth: depth[0] for M1, depth[1] for M2. The number of commands
+			waiting in the buffer. 0 means the last command is running and
+			ROBOBUFFEREMPTY means it has finished.
+
+	Returns:
+		ERROR: USART timeout or CRC check error
+		NOERROR
+------------------------------------------------------------------------------*/
+uint8_t get_MOTORBuffer(uint8_t controller, uint8_t *depth)
+{
+
+	uint8_t data[2];
+
+	if (start_MOTORRead(controller, ROBOREADBUFFER, 4) == ERROR) {
+		return(ERROR);
+	}
+	if (end_MOTORRead(data) == ERROR) {
+		return(ERROR);
+	}
+
+	depth[0] = data[0];
+	depth[1] = data[1];
+	return(NOERROR);
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t get_MOTORCurrent(uint8_t axis, uint16_t *current)
+	Motor current for one axis. Command 49 returns both channels; this
+	picks the axis's half.
+
+	Inputs:
+		axis: index into axes[]
+
+	Outputs:
+		current: motor current in 10 mA units (0x7FFF on error)
+
+	Returns:
+		ERROR: USART timeout or CRC error
+		NOERROR
+------------------------------------------------------------------------------*/
+uint8_t get_MOTORCurrent(uint8_t axis, uint16_t *current)
+{
+
+	uint32_t icurrents;
+
+	if (get_MOTORInt32(axes[axis].address, ROBOREADCURRENT, &icurrents) == ERROR) {
+		*current = 0x7FFF;
+		return(ERROR);
+	}
+	if (axes[axis].channel == 1) {
+		*current = (uint16_t) (icurrents >> 16);
+	} else {
+		*current = (uint16_t) (icurrents & 0xFFFF);
+	}
+	count_USECURRENT(axis, *current);
+	return(NOERROR);
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t get_MOTOREncoder(uint8_t axis, uint8_t command, uint32_t *value)
 	Gets the 32-bit encoder value and speed
 
 	Inputs:
-		controller: the controller address (128, 129, or 130)
+		axis: index into axes[]
 		command:	ROBOREADENCODERCOUNT (command 16) or
-					ROBOREADENCODERSPEED (command 18)
+					ROBOREADENCODERSPEED (command 18). The M1 command number;
+					it's bumped by one for an M2 axis.
 
 	Output:
 		value: the encoder value or speed. It's declared as an unsigned
 			integer but sprintf interprets it correctly if it's negative.
 
 	Returns
-		ERROR on USART timeout or 0xFF reply error
+		ERROR on USART timeout or CRC error
 		NOERROR otherwise
-
-	Also available but not output here:
-		status - from page 86 of version 5.7 of the manual:
-			Bit0: Counter underflow (1=underflow occurred, clear after reading)
-			Bit1: Direction (0=forward, 1-backwards)
-			Bit2: Counter overflow (1=overflow occurred, clear after reading)
-			Bits 3-7 are "reserved." Bit7 is 1.
 ------------------------------------------------------------------------------*/
-uint8_t get_MOTOREncoder(uint8_t controller, uint8_t command, int32_t *value)
+uint8_t get_MOTOREncoder(uint8_t axis, uint8_t command, int32_t *value)
 {
-	uint8_t i, tbuf[7];
-	uint16_t crcReceived, crcExpected;
 
-	recv1_buf.nbytes = 7;			// Set up reply buffer
-	recv1_buf.nxfrd = 0;
-	recv1_buf.done = NO;
+	if (start_MOTOREncoder(axis, command) == ERROR) {
+		return(ERROR);
+	}
+	return(end_MOTOREncoder(value));
 
-	tbuf[0] = controller;
-	tbuf[1] = command;
-	send_USART(1, tbuf, 2);			// Send the command
+}
 
-	start_TCB0(1);
-	while (recv1_buf.done == NO) {	// Wait for the reply
-		asm("nop");
-		if (ticks > 50) {			// Timeout
-			stop_TCB0();
-			printError(ERR_MTRREADENC, "get_MOTOREncoder timeout");
-			return(ERROR);
-		}
-	}
-	stop_TCB0();
+/*------------------------------------------------------------------------------
+uint8_t get_MOTORMark(uint8_t axis, uint8_t *marked)
+	Has the axis's channel been marked since the RoboClaw powered up? Reads
+	the default duty accelerations (command 81, both channels) and compares
+	the channel's with ROBOPOWERMARK (see set_MOTORMark).
 
-	crcReceived = (recv1_buf.data[5] << 8) | recv1_buf.data[6];
+	Output:
+		marked: YES or NO
 
-	for (i = 2; i < 7; i++) {		// Compute expected crc value
-		tbuf[i] = recv1_buf.data[i-2];
-	}
-	crcExpected = crc16(tbuf, 7);
+	Returns:
+		ERROR: USART timeout or CRC check error
+		NOERROR
+------------------------------------------------------------------------------*/
+uint8_t get_MOTORMark(uint8_t axis, uint8_t *marked)
+{
 
-	if (crcReceived != crcExpected) {
-		*value = 0;
-		printError(ERR_MTRENCCRC, "get_MOTOREncoder CRC");
+	uint8_t data[8], *p;
+	uint32_t accel;
+
+	if (start_MOTORRead(axes[axis].address, ROBOREADDUTYACCEL, 10) == ERROR) {
+		return(ERROR);
+	}
+	if (end_MOTORRead(data) == ERROR) {
 		return(ERROR);
 	}
 
-	*value =  (uint32_t) recv1_buf.data[0] << 24;
-	*value |= (uint32_t) recv1_buf.data[1] << 16;
-	*value |= (uint32_t) recv1_buf.data[2] << 8;
-	*value |= (uint32_t) recv1_buf.data[3];
-
-//	status = recv1_buf.data[4];
-
+	p = &data[(axes[axis].channel - 1) * 4];
+	accel =  (uint32_t) p[0] << 24;
+	accel |= (uint32_t) p[1] << 16;
+	accel |= (uint32_t) p[2] << 8;
+	accel |= (uint32_t) p[3];
+	*marked = (accel == ROBOPOWERMARK) ? YES : NO;
 	return(NOERROR);
 
 }
@@ -190,46 +414,21 @@ uint8_t get_MOTORFloat(uint8_t controller, uint8_t command, float *value)
 ------------------------------------------------------------------------------*/
 uint8_t get_MOTORFloat(uint8_t controller, uint8_t command, float *value)
 {
-	uint8_t tbuf[4];
-	uint16_t tempval, crcReceived, crcExpected;
 
-	recv1_buf.nbytes = 4;				// Set up receive buffer
-	recv1_buf.nxfrd = 0;
-	recv1_buf.done = NO;
+	uint8_t data[2];
+	uint16_t tempval;
 
-	tbuf[0] = controller;
-	tbuf[1] = command;
-	send_USART(1, tbuf, 2);				// Send command
-
-	start_TCB0(1);
-	for (;;) {
-		if (recv1_buf.done == YES) {	// Receive reply
-			break;
-		}
-		if (ticks > 50) {				// Timeout
-			stop_TCB0();
-			printError(ERR_MTRREADENC, "ROBOFloat timeout");
-			return(ERROR);
-		}
+	if (start_MOTORRead(controller, command, 4) == ERROR) {
+		return(ERROR);
 	}
-	stop_TCB0();
-
-	tempval = (recv1_buf.data[0] << 8) | recv1_buf.data[1];
-	crcReceived = (recv1_buf.data[2] << 8) | recv1_buf.data[3];
-
-	tbuf[0] = controller;
-	tbuf[1] = command;
-	tbuf[2] = recv1_buf.data[0];
-	tbuf[3] = recv1_buf.data[1];
-	crcExpected = crc16(tbuf, 4);
-
-	if (crcExpected != crcReceived) {
-		printError(ERR_MTRENCCRC, "get_MOTORFloat CRC");
+	if (end_MOTORRead(data) == ERROR) {
 		return(ERROR);
-	} else {
-		*value = ((float) tempval / 10.0);
-		return(NOERROR);
 	}
+
+	tempval = (data[0] << 8) | data[1];
+	*value = ((float) tempval / 10.0);
+	return(NOERROR);
+
 }
 
 /*------------------------------------------------------------------------------
@@ -251,63 +450,122 @@ uint8_t get_MOTORInt32(uint8_t controller, uint8_t command, uint32_t *value)
 ------------------------------------------------------------------------------*/
 uint8_t get_MOTORInt32(uint8_t controller, uint8_t command, uint32_t *value)
 {
-	uint8_t i, tbuf[6];
-	uint16_t crcReceived, crcExpected;
+
+	uint8_t data[4];
 	uint32_t tempval;
 
-	recv1_buf.nbytes = 6;				// Set up receive buffer
-	recv1_buf.nxfrd = 0;
-	recv1_buf.done = NO;
+	if ((start_MOTORRead(controller, command, 6) == ERROR) ||
+		(end_MOTORRead(data) == ERROR)) {
+		*value = 0x7FFFFFFF;
+		return(ERROR);
+	}
 
-	tbuf[0] = controller;
-	tbuf[1] = command;
-	send_USART(1, tbuf, 2);				// Send command
+	tempval =  (uint32_t) data[0] << 24;
+	tempval |= (uint32_t) data[1] << 16;
+	tempval |= (uint32_t) data[2] << 8;
+	tempval |= (uint32_t) data[3];
+	*value = tempval;
 
-	start_TCB0(1);
-	for (;;) {
-		if (recv1_buf.done == YES) {	// Receive reply
-			stop_TCB0();
-			break;
-		}
-		if (ticks > 50) {				// Timeout
-			stop_TCB0();
-			printError(ERR_MTRTIMEOUT, "get_MOTORInt32 timeout");
-			return(ERROR);
-		}
-	}
+	return(NOERROR);
 
-	crcReceived = (recv1_buf.data[4] << 8) | recv1_buf.data[5];
+}
 
-	for (i = 2; i < 6; i++) {			// Compute expected CRC
-		tbuf[i] = recv1_buf.data[i-2];
-	}
-	crcExpected = crc16(tbuf, 6);
+/*------------------------------------------------------------------------------
+uint8_t get_MOTORProfile(uint8_t axis, char name, int32_t distance,
+	MotionProfile *profile)
+	Look up a motion profile for a move
 
-	if (crcReceived != crcExpected) {
-		printError(ERR_MTRENCCRC, "get_MOTORInt32 CRC error");
-		*value = 0x7FFFFFFF;
-		return(ERROR);
+	Inputs:
+		axis: index into axes[]
+		name: profile letter from the m command (n, f, s, or a)
+		distance: move length in encoder counts (sign doesn't matter)
+
+	Outputs:
+		profile: acceleration, speed, and deceleration to send
+
+	Returns:
+		ERROR if the profile name is unknown
+		NOERROR otherwise
+
+	The auto profile (a) uses the axis's acceleration limit for moves shorter
+	than AUTODISTANCE microns, with the cruise speed set to the peak the move
+	can reach (sqrt(acceleration * distance)), or the axis's speed limit if
+	that's lower, so what's sent is what the motor runs. Longer moves use the
+	nominal profile. Every profile is held to the axis's limits
+	(axes[].maxAcceleration and maxSpeed).
+------------------------------------------------------------------------------*/
+uint8_t get_MOTORProfile(uint8_t axis, char name, int32_t distance,
+	MotionProfile *profile)
+{
+
+	uint8_t i;
+	uint32_t speed, root, bit;
+
+	if (name == 'a') {
+		if (distance < 0) {
+			distance = -distance;
+		}
+		if (distance >= (AUTODISTANCE * (int32_t) axes[axis].countsPerMicron)) {
+			name = 'n';
+		} else {
+			profile->name = 'a';
+			profile->acceleration = axes[axis].maxAcceleration;
+			profile->deceleration = axes[axis].maxAcceleration;
+			profile->speed = axes[axis].maxSpeed;
+			speed = axes[axis].maxAcceleration * (uint32_t) distance;	// Integer square root
+			root = 0;
+			for (bit = 1UL << 30; bit; bit >>= 2) {
+				if (speed >= root + bit) {
+					speed -= root + bit;
+					root = (root >> 1) + bit;
+				} else {
+					root >>= 1;
+				}
+			}
+			if (root < profile->speed) {
+				profile->speed = (root > 0) ? root : 1;
+			}
+			return(NOERROR);
+		}
 	}
 
-	tempval =  (uint32_t) recv1_buf.data[0] << 24;
-	tempval |= (uint32_t) recv1_buf.data[1] << 16;
-	tempval |= (uint32_t) recv1_buf.data[2] << 8;
-	tempval |= (uint32_t) recv1_buf.data[3];
-	*value = tempval;
+	for (i = 0; i < (sizeof(motionProfiles)/sizeof(MotionProfile)); i++) {
+		if (motionProfiles[i].name == name) {
+			*profile = motionProfiles[i];
+			if (profile->acceleration > axes[axis].maxAcceleration) {
+				profile->acceleration = axes[axis].maxAcceleration;
+			}
+			if (profile->deceleration > axes[axis].maxAcceleration) {
+				profile->deceleration = axes[axis].maxAcceleration;
+			}
+			if (profile->speed > axes[axis].maxSpeed) {
+				profile->speed = axes[axis].maxSpeed;
+			}
+			return(NOERROR);
+		}
+	}
 
-	return(NOERROR);
+	printError(ERR_MTRPROFILE, "move_MOTOR unknown profile");
+	return(ERROR);
 
 }
 
 /*------------------------------------------------------------------------------
 uint8_t init_MOTORS(void)
-	Reads the last-saved encoder value from FRAM and loads it into the three
-	controllers. No error message is output on first call (reboot).
+	Reconciles each axis in the registry with the encoder value saved in
+	FRAM. After restoring an axis its channel is marked with a setting the
+	RoboClaw keeps only in RAM (see set_MOTORMark). A marked channel kept
+	power through a specMech-only reboot, so its count is exact and is
+	left alone; the FRAM value can be minutes old. An unmarked channel lost
+	power and started from 0, so the saved value is loaded if anything has
+	been saved (ENCSEQADDR isn't 0). A channel is marked only once its
+	restore worked, so a failed one is tried again at the next reboot. No
+	error message is output on first call (reboot).
 
 	Inputs: None
 	Outputs: None
 	Returns
-		ERROR if set_MOTOREncoder fails
+		ERROR if a controller can't be read or set_MOTOREncoder fails
 		NOERROR otherwise
 
 NEED TO FIGURE OUT WHAT TO DO ABOUT ERRORS
@@ -315,28 +573,45 @@ NEED TO FIGURE OUT WHAT TO DO ABOUT ERRORS
 uint8_t init_MOTORS(void)
 {
 
-	static uint8_t firstTime[3] = {YES, YES, YES};
-	uint8_t controller, error = 0;
+	static uint8_t calledBefore[NAXES];
+	uint8_t axis, error = 0, marked, tbuf[2];
 	int32_t encoderValue;
 
-char str[25];
-
 	timerSAVEENCODER = 0;
-	timeoutSAVEENCODER = SAVEENCODERFREQUENCY;
-
-	for (controller = 128; controller < 131; controller++) {
-//		encoderValue = -22 * ROBOCOUNTSPERMICRON;	// Proxy for now		
-		// get saved encoder value from FRAM
-		getFRAM_MOTOREncoder(controller, &encoderValue);
+	if (bodArmed) {						// The VLM saves at power fail
+		timeoutSAVEENCODER = SAVEENCODERBOD;
+	} else {
+		timeoutSAVEENCODER = SAVEENCODERFREQUENCY;
+	}
 
-sprintf(str, "encval=%ld\r\n", encoderValue);
-send_USART(0, (uint8_t*) str, strlen(str));
+	if (read_FRAM(FRAMTWIADDR, ENCSEQADDR, tbuf, 2) == ERROR) {
+		encoderSeq = 0;
+	} else {
+		encoderSeq = ((uint16_t) tbuf[0] << 8) | tbuf[1];
+	}
 
-		if (set_MOTOREncoder(controller, encoderValue) == ERROR) {
-			if (!firstTime[controller - 128]) {
+	for (axis = 0; axis < NAXES; axis++) {
+		if (get_MOTORMark(axis, &marked) == ERROR) {
+			if (calledBefore[axis]) {
+				printError(ERR_MTRSETENC, "init_MOTORS read");
+			}
+			calledBefore[axis] = YES;
+			error++;
+			continue;
+		}
+		calledBefore[axis] = YES;
+		if (marked) {					// Kept power, its count is exact
+			continue;
+		}
+		if ((encoderSeq != 0) && (getFRAM_MOTOREncoder(axis, &encoderValue) == NOERROR)) {
+			if (set_MOTOREncoder(axis, encoderValue) == ERROR) {
 				printError(ERR_MTRSETENC, "init_MOTORS");
-				firstTime[controller - 128] = NO;
+				error++;
+				continue;
 			}
+		}
+		if (set_MOTORMark(axis) == ERROR) {
+			printError(ERR_MTRSETENC, "init_MOTORS mark");
 			error++;
 		}
 	}
@@ -352,7 +627,7 @@ uint8_t motorsMoving(void)
 	uint8_t i;
 	int32_t encoderSpeed;
 
-	for (i = MOTORAADDR; i <= MOTORCADDR; i++) {
+	for (i = 0; i < NAXES; i++) {
 		get_MOTOREncoder(i, ROBOREADENCODERSPEED, &encoderSpeed);
 		if (encoderSpeed) {
 			return(YES);
@@ -368,84 +643,140 @@ uint8_t move_MOTOR(uint8_t cstack)
 	Move to a new relative or absolute position. Called by the m command.
 
 	Input:
-		cstack: command stack position
+		cstack: command stack position. The value is the position (A, B, C)
+			or increment (a, b, c) in microns, optionally followed by a
+			motion profile, e.g. "ma5:f". The profiles are :n (nominal),
+			:f (fast), :s (slow), and :a (auto). The default is the axis's
+			profile in axes[]. Any axis in the registry can be moved.
+
+			Up to WPTMAX waypoints can be given separated by '/', each with
+			its own profile, e.g. "mA100:f/200/300:s". Increments are from
+			the previous waypoint. The whole list is loaded into the
+			RoboClaw command buffer at once (the first segment replaces
+			anything already there) and check_WAYPOINTS reports each one
+			as it finishes.
 
 	Returns:
-		ERROR if an unknown motor designator (not A, B, C, or a, b, c) is read
+		ERROR if an unknown axis or profile is read
 		NOERROR otherwise
 ------------------------------------------------------------------------------*/
 uint8_t move_MOTOR(uint8_t cstack)
 {
 
-	uint8_t motor, controller, retval;
-	int32_t newPosition, currentPosition;
+	char *ptr, profileName;
+	uint8_t motor, axis, absolute, known, i, nsegments, buffer;
+	int32_t currentPosition, lastPosition, distance, target[WPTMAX];
+	MotionProfile profile[WPTMAX];
 
 	motor = pcmd[cstack].cobject;
-	switch(motor) {
-		case 'A':
-		case 'B':
-		case 'C':
-			controller = motor + 63;
-			currentPosition = 0;
-			break;
-
-		case 'a':
-		case 'b':
-		case 'c':
-			controller = motor + 31;
-			retval = get_MOTOREncoder(controller, ROBOREADENCODERCOUNT, &currentPosition);
-			if (retval == ERROR) {
-				return(ERROR);
-			}
-			break;
-
-		default:
-			printError(ERR_UNKNOWNMTR, "move_MOTOR unknown motor");
-			return(ERROR);
-			break;	
+	if ((axis = get_AXIS(motor)) == ERROR) {
+		printError(ERR_UNKNOWNMTR, "move_MOTOR unknown motor");
+		return(ERROR);
 	}
+	absolute = ((motor >= 'A') && (motor <= 'Z'));	// Uppercase is absolute
 
 	if (pcmd[cstack].cvalue[0] == '\0') {	// Don't do anything on null distance
 		printError(ERR_MTRNULLMOVE, "move_MOTOR no position or increment");
 		return(ERROR);
 	}
 
-	newPosition = currentPosition + (atol(pcmd[cstack].cvalue) * ROBOCOUNTSPERMICRON);
-	return(move_MOTORAbsolute(controller, newPosition));
+	known = YES;
+	if (get_MOTOREncoder(axis, ROBOREADENCODERCOUNT, &currentPosition) == ERROR) {
+		if (!absolute) {
+			return(ERROR);
+		}
+		known = NO;					// Auto profile falls back to nominal
+		currentPosition = 0;
+	}
+
+	ptr = pcmd[cstack].cvalue;		// Check every segment before sending any
+	lastPosition = currentPosition;
+	for (nsegments = 0; *ptr != '\0'; nsegments++) {
+		if (nsegments >= WPTMAX) {
+			printError(ERR_MTRWAYPOINTS, "move_MOTOR too many waypoints");
+			return(ERROR);
+		}
+		target[nsegments] = atol(ptr) * (int32_t) axes[axis].countsPerMicron;
+		if (!absolute) {
+			target[nsegments] += lastPosition;
+		}
+		while ((*ptr != '\0') && (*ptr != ':') && (*ptr != '/')) {
+			ptr++;
+		}
+		profileName = axes[axis].profile;
+		if (*ptr == ':') {
+			profileName = *(++ptr);
+			while ((*ptr != '\0') && (*ptr != '/')) {
+				ptr++;
+			}
+		}
+		if (*ptr == '/') {
+			ptr++;
+		}
+		distance = (known || nsegments) ? (target[nsegments] - lastPosition) :
+			(AUTODISTANCE * (int32_t) axes[axis].countsPerMicron);
+		if (get_MOTORProfile(axis, profileName, distance, &profile[nsegments]) == ERROR) {
+			return(ERROR);
+		}
+		lastPosition = target[nsegments];
+	}
+
+	lastPosition = currentPosition;
+	for (i = 0; i < nsegments; i++) {
+		buffer = ((nsegments > 1) && (i == 0)) ? ROBOIMMEDIATE : ROBOBUFFERED;
+		if (move_MOTORAbsolute(axis, target[i], &profile[i], buffer) == ERROR) {
+			stop_WAYPOINTS(axis);
+			return(ERROR);
+		}
+		count_USEMOVE(axis, (known || i) ? (target[i] - lastPosition) : 0, &profile[i]);
+		lastPosition = target[i];
+	}
+
+	if (nsegments > 1) {
+		start_WAYPOINTS(axis, nsegments, pcmd[cstack].cid);
+	} else {
+		stop_WAYPOINTS(axis);
+	}
+	start_TRAJECTORY(axis, target[nsegments-1], &profile[0]);	// If the recorder is armed
+	return(NOERROR);
 
 }
 
 /*------------------------------------------------------------------------------
-uint8_t move_MOTORAbsolute(uint8_t controller, int32_t newPosition)
-	Move the motor on the selected controller to a new absolute position.
+uint8_t move_MOTORAbsolute(uint8_t axis, int32_t newPosition,
+	MotionProfile *profile, uint8_t buffer)
+	Move an axis to a new absolute position.
 
 	Inputs:
-		controller: controller address (128, 129, or 130)
+		axis: index into axes[]
 		newPosition: the new encoder position in native encoder units
+		profile: acceleration, speed, and deceleration (see get_MOTORProfile)
+		buffer: ROBOBUFFERED to run after the moves already in the RoboClaw
+			buffer, ROBOIMMEDIATE to stop and replace them
 
 	Returns:
 		ERROR on USART timeout or bad (not 0xFF) ack
 		NOERROR otherwise
 ------------------------------------------------------------------------------*/
-uint8_t move_MOTORAbsolute(uint8_t controller, int32_t newPosition)
+uint8_t move_MOTORAbsolute(uint8_t axis, int32_t newPosition,
+	MotionProfile *profile, uint8_t buffer)
 {
 
-	uint8_t tbuf[21], buffer;
+	uint8_t tbuf[21];
 	uint16_t crc;
 	uint32_t acceleration, deceleration, speed;
 
-	acceleration = ACCELERATION;
-	deceleration = DECELERATION;
-	speed = SPEED;
-	buffer = 0;							// 0 -> command is buffered
+	acceleration = profile->acceleration;
+	deceleration = profile->deceleration;
+	speed = profile->speed;
 
 	recv1_buf.data[0] = 0x00;			// Set up receiving buffer
 	recv1_buf.nbytes = 1;
 	recv1_buf.nxfrd = 0;
 	recv1_buf.done = NO;
 
-	tbuf[0] = controller;
-	tbuf[1] = ROBODRIVETO;				// Command 65
+	tbuf[0] = axes[axis].address;
+	tbuf[1] = ROBODRIVETO + axes[axis].channel - 1;	// Command 65 (M1) or 66 (M2)
 	tbuf[2] = (acceleration >> 24) & 0XFF;
 	tbuf[3] = (acceleration >> 16) & 0xFF;
 	tbuf[4] = (acceleration >> 8) & 0xFF;
@@ -475,8 +806,13 @@ uint8_t move_MOTORAbsolute(uint8_t controller, int32_t newPosition)
 			stop_TCB0();
 			break;
 		}
+		if (powerFail) {				// Give way to save_POWERFAIL
+			stop_TCB0();
+			return(ERROR);
+		}
 		if (ticks > 50) {				// 4 ms just barely works at 38400 baud
 			stop_TCB0();
+			count_LINK(LNKROBOCLAW, LNKTIMEOUT);
 			printError(ERR_MTRTIMEOUT, "move_MOTORAbsolute timeout");
 			return(ERROR);
 		}
@@ -491,11 +827,11 @@ uint8_t move_MOTORAbsolute(uint8_t controller, int32_t newPosition)
 }
 
 /*------------------------------------------------------------------------------
-uint8_t putFRAM_MOTOREncoder(uint8_t controller)
+uint8_t putFRAM_MOTOREncoder(uint8_t axis)
 	Stores the encoder value in FRAM.
 
 	Inputs:
-		controller: The controller address (128, 129, or 130)
+		axis: index into axes[]
 
 	Outputs:
 		None
@@ -504,77 +840,119 @@ uint8_t putFRAM_MOTOREncoder(uint8_t controller)
 		ERROR on get_MOTOREncoder or write_FRAM failure
 		NOERROR otherwise
 ------------------------------------------------------------------------------*/
-uint8_t putFRAM_MOTOREncoder(uint8_t controller)
+uint8_t putFRAM_MOTOREncoder(uint8_t axis)
+{
+
+	int32_t encoderValue;
+
+	if (get_MOTOREncoder(axis, ROBOREADENCODERCOUNT, &encoderValue) == ERROR) {
+		return(ERROR);
+	}
+	return(putFRAM_MOTORValue(axis, encoderValue));
+
+}
+
+/*------------------------------------------------------------------------------
+void putFRAM_MOTORSeq(void)
+	Count a pass that saved encoders (ENCSEQADDR). 0 means never saved.
+------------------------------------------------------------------------------*/
+void putFRAM_MOTORSeq(void)
+{
+
+	uint8_t tbuf[2];
+
+	encoderSeq++;
+	if (encoderSeq == 0) {
+		encoderSeq = 1;
+	}
+	tbuf[0] = encoderSeq >> 8;
+	tbuf[1] = encoderSeq & 0xFF;
+	write_FRAM(FRAMTWIADDR, ENCSEQADDR, tbuf, 2);
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t putFRAM_MOTORValue(uint8_t axis, int32_t value)
+	Store an encoder count in the axis's FRAM slot
+------------------------------------------------------------------------------*/
+uint8_t putFRAM_MOTORValue(uint8_t axis, int32_t value)
 {
 
 	uint8_t tbuf[4];
-	uint16_t memaddr;
-	int32_t oldencoderValue, encoderValue;
 
-	switch (controller) {
-		case MOTORAADDR:
-			memaddr = ENCAFRAMADDR;
-			break;
+	tbuf[0] = (value >> 24) & 0xFF;
+	tbuf[1] = (value >> 16) & 0xFF;
+	tbuf[2] = (value >> 8) & 0xFF;
+	tbuf[3] = value & 0xFF;
 
-		case MOTORBADDR:
-			memaddr = ENCBFRAMADDR;
-			break;
+	return(write_FRAM(FRAMTWIADDR, axes[axis].framaddr, tbuf, 4));
 
-		case MOTORCADDR:
-			memaddr = ENCCFRAMADDR;
-			break;
+}
 
-		default:
-			return(ERROR);
+uint8_t saveFRAM_MOTOREncoders(void)
+{
+	uint8_t i, error = 0, saved = 0;
+
+	for (i = 0; i < NAXES; i++) {
+		if (putFRAM_MOTOREncoder(i) == NOERROR) {
+			saved++;
+		} else {
+			error++;
+		}
 	}
-/*
-	if (read_FRAM(FRAMTWIADDR, memaddr, tbuf, 4) == ERROR) {
-		return(ERROR);
+	if (saved) {
+		putFRAM_MOTORSeq();
 	}
-
-	oldencoderValue =  (uint32_t) tbuf[0] << 24;
-	oldencoderValue |= (uint32_t) tbuf[1] << 16;
-	oldencoderValue |= (uint32_t) tbuf[2] << 8;
-	oldencoderValue |= (uint32_t) tbuf[3];
-*/
-	if (get_MOTOREncoder(controller, ROBOREADENCODERCOUNT, &encoderValue) == ERROR) {
+	if (error) {
 		return(ERROR);
-	}
-/*
-	if (oldencoderValue == encoderValue) {
+	} else {
 		return(NOERROR);
 	}
-*/
-	tbuf[0] = (encoderValue >> 24) & 0xFF;
-	tbuf[1] = (encoderValue >> 16) & 0xFF;
-	tbuf[2] = (encoderValue >> 8) & 0xFF;
-	tbuf[3] = encoderValue & 0xFF;
-
-	return(write_FRAM(FRAMTWIADDR, memaddr, tbuf, 4));
-
 }
 
-uint8_t saveFRAM_MOTOREncoders(void)
+/*------------------------------------------------------------------------------
+uint8_t saveFRAM_MOTORLast(void)
+	The power-fail save: write each axis's last-read count (lastEncoder) to
+	FRAM without going to the RoboClaws. Reads take up to ROBOTIMEOUT each
+	and a controller that's losing power won't answer. An axis that hasn't
+	been read since power-up keeps what's in FRAM.
+
+	Returns:
+		ERROR if a write_FRAM failed
+		NOERROR otherwise
+------------------------------------------------------------------------------*/
+uint8_t saveFRAM_MOTORLast(void)
 {
-	uint8_t i, error = 0, retval;
 
-	for (i = MOTORAADDR; i <= MOTORCADDR; i++) {
-		retval = putFRAM_MOTOREncoder(i);
-		error += retval;
+	uint8_t i, error = 0, saved = 0;
+
+	for (i = 0; i < NAXES; i++) {
+		if (!lastEncoderOK[i]) {
+			continue;
+		}
+		if (putFRAM_MOTORValue(i, lastEncoder[i]) == NOERROR) {
+			saved++;
+		} else {
+			error++;
+		}
+	}
+	if (saved) {
+		putFRAM_MOTORSeq();
 	}
 	if (error) {
 		return(ERROR);
 	} else {
 		return(NOERROR);
 	}
+
 }
 
 /*------------------------------------------------------------------------------
-uint8_t set_MOTOREncoder(uint8_t controller, uint32_t value)
+uint8_t set_MOTOREncoder(uint8_t axis, uint32_t value)
 	Loads an encoder value into a controller
 
 	Inputs:
-		controller: the motor controller (128, 129, or 130)
+		axis: index into axes[]
 		value: the encoder value to load
 
 	Outputs:
@@ -589,7 +967,7 @@ uint8_t set_MOTOREncoder(uint8_t controller, uint32_t value)
 		double-check at startup to make sure the encoder values agree before
 		a move.
 ------------------------------------------------------------------------------*/
-uint8_t set_MOTOREncoder(uint8_t controller, int32_t value)
+uint8_t set_MOTOREncoder(uint8_t axis, int32_t value)
 {
 
 	uint8_t tbuf[6];
@@ -599,14 +977,14 @@ uint8_t set_MOTOREncoder(uint8_t controller, int32_t value)
 	recv1_buf.nxfrd = 0;
 	recv1_buf.done = NO;
 
-	tbuf[0] = controller;
-	tbuf[1] = ROBOSETENCODER;
+	tbuf[0] = axes[axis].address;
+	tbuf[1] = ROBOSETENCODER + axes[axis].channel - 1;
 	tbuf[2] = (value >> 24) & 0xFF;
 	tbuf[3] = (value >> 16) & 0xFF;
 	tbuf[4] = (value >> 8) & 0xFF;
 	tbuf[5] = value & 0xFF;
 
-	send_USART(1, tbuf, 6);				// Send the command
+	send_USART(1, tbuf, 6);				// Send the command (send_USART adds the CRC)
 
 	start_TCB0(1);						// Start 1 ms ticks timer
 	for (;;) {
@@ -614,8 +992,71 @@ uint8_t set_MOTOREncoder(uint8_t controller, int32_t value)
 			stop_TCB0();
 			break;
 		}
+		if (powerFail) {				// Give way to save_POWERFAIL
+			stop_TCB0();
+			return(ERROR);
+		}
 		if (ticks > 50) {				// 4 ms barely works at 38400 baud
 			stop_TCB0();
+			count_LINK(LNKROBOCLAW, LNKTIMEOUT);
+			return(ERROR);
+		}
+	}
+
+	if (recv1_buf.data[0] != 0xFF) {	// Bad ack
+		return(ERROR);
+	}
+
+	lastEncoder[axis] = value;
+	lastEncoderOK[axis] = YES;
+	return(NOERROR);
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t set_MOTORMark(uint8_t axis)
+	Mark the axis's channel as restored since power-up by setting its
+	default duty acceleration (command 68 or 69) to ROBOPOWERMARK. Duty
+	commands aren't used here so the value doesn't matter to the motor,
+	and it isn't written to the RoboClaw's EEPROM, so it's gone at the next
+	power-up (get_MOTORMark).
+
+	Returns:
+		ERROR on USART timeout or bad (not 0xFF) ack
+		NOERROR otherwise
+------------------------------------------------------------------------------*/
+uint8_t set_MOTORMark(uint8_t axis)
+{
+
+	uint8_t tbuf[6];
+
+	recv1_buf.data[0] = 0x00;			// Set up receiving buffer
+	recv1_buf.nbytes = 1;
+	recv1_buf.nxfrd = 0;
+	recv1_buf.done = NO;
+
+	tbuf[0] = axes[axis].address;
+	tbuf[1] = ROBOSETDUTYACCEL + axes[axis].channel - 1;
+	tbuf[2] = ((uint32_t) ROBOPOWERMARK >> 24) & 0xFF;
+	tbuf[3] = ((uint32_t) ROBOPOWERMARK >> 16) & 0xFF;
+	tbuf[4] = ((uint32_t) ROBOPOWERMARK >> 8) & 0xFF;
+	tbuf[5] = (uint32_t) ROBOPOWERMARK & 0xFF;
+
+	send_USART(1, tbuf, 6);				// Send the command (send_USART adds the CRC)
+
+	start_TCB0(1);						// Start 1 ms ticks timer
+	for (;;) {
+		if (recv1_buf.done == YES) {	// Reply received
+			stop_TCB0();
+			break;
+		}
+		if (powerFail) {				// Give way to save_POWERFAIL
+			stop_TCB0();
+			return(ERROR);
+		}
+		if (ticks > 50) {
+			stop_TCB0();
+			count_LINK(LNKROBOCLAW, LNKTIMEOUT);
 			return(ERROR);
 		}
 	}
@@ -627,3 +1068,55 @@ uint8_t set_MOTOREncoder(uint8_t controller, int32_t value)
 	return(NOERROR);
 
 }
+
+/*------------------------------------------------------------------------------
+uint8_t start_MOTOREncoder(uint8_t axis, uint8_t command)
+	Send an encoder read (ROBOREADENCODERCOUNT or ROBOREADENCODERSPEED, the
+	M1 command number) for an axis. Finish it with end_MOTOREncoder.
+------------------------------------------------------------------------------*/
+uint8_t start_MOTOREncoder(uint8_t axis, uint8_t command)
+{
+
+	return(start_MOTORRead(axes[axis].address, command + axes[axis].channel - 1, 7));
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t start_MOTORRead(uint8_t controller, uint8_t command, uint8_t nbytes)
+	Send a RoboClaw read command and return without waiting for the reply.
+	USART1 stays owned until end_MOTORRead collects the reply, so only one
+	read can be under way.
+
+	Inputs:
+		controller: controller address (128-135)
+		command: RoboClaw command number
+		nbytes: length of the reply, including its two CRC bytes
+
+	Returns:
+		ERROR if another read hasn't been finished
+		NOERROR otherwise
+------------------------------------------------------------------------------*/
+uint8_t start_MOTORRead(uint8_t controller, uint8_t command, uint8_t nbytes)
+{
+
+	uint8_t tbuf[2];
+
+	if (claim_BUS(BUSUSART1) == ERROR) {
+		printError(ERR_BUSOWNED, "RoboClaw read already under way");
+		return(ERROR);
+	}
+
+	roboController = controller;
+	roboCommand = command;
+	recv1_buf.nbytes = nbytes;			// Set up the reply buffer
+	recv1_buf.nxfrd = 0;
+	recv1_buf.done = NO;
+
+	tbuf[0] = controller;
+	tbuf[1] = command;
+	send_USART(1, tbuf, 2);				// Send the command
+	roboStart = get_RTCTicks();
+
+	return(NOERROR);
+
+}
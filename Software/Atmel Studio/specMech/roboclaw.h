@@ -4,38 +4,88 @@
 #include "globals.h"
 
 #define ROBOCOUNTSPERMICRON		268	// Needs checking
-#define ACCELERATION			8192
+#define ACCELERATION			8192	// Nominal profile (counts/sec/sec)
 #define DECELERATION			8192
-#define SPEED					16384
+#define SPEED					16384	// counts/sec
+#define FASTACCELERATION		32768	// Fast profile, and the default axis limits
+#define FASTDECELERATION		32768	// (Axis.maxAcceleration, Axis.maxSpeed)
+#define FASTSPEED				32768
+#define SLOWACCELERATION		2048	// Slow profile
+#define SLOWDECELERATION		2048
+#define SLOWSPEED				4096
+#define AUTODISTANCE			25		// Auto profile uses fast below this (microns)
 #define SAVEENCODERFREQUENCY	11	// Save encoder period (sec)
+#define SAVEENCODERBOD			240	// Period when the BOD power-fail save is armed (sec)
 #define MOTORAADDR	128
 #define MOTORBADDR	129
 #define MOTORCADDR	130
-#define ROBOREADENCODERCOUNT	16
-#define ROBOREADENCODERSPEED	18
+#define NAXES		3		// Entries in the axes[] table (roboclaw.c)
+#define ROBOREADENCODERCOUNT	16		// M1; add 1 for M2 (see Axis.channel)
+#define ROBOREADENCODERSPEED	18		// M1; M2 is 19
 #define ROBOREADFIRMWARE		21
-#define ROBOSETENCODER			22
+#define ROBOSETENCODER			22		// M1; M2 is 23
 #define ROBOREADMAINVOLTAGE		24
-#define ROBOREADCURRENT			49
-#define ROBODRIVETO				65
+#define ROBOREADBUFFER			47		// Both channels in one reply
+#define ROBOREADCURRENT			49		// Both channels in one reply
+#define ROBOSETDUTYACCEL		68		// M1; M2 is 69 (the power-up mark)
+#define ROBOREADDUTYACCEL		81		// Both channels in one reply
+#define ROBODRIVETO				65		// M1; M2 is 66
 #define ROBOREADTEMPERATURE		82
 #define ROBOMOVETO				119
-#define ROBOFAST				64
-#define ROBOSLOW				16
+#define ROBOBUFFERED			0		// Drive command waits its turn in the buffer
+#define ROBOIMMEDIATE			1		// Drive command replaces the buffer
+#define ROBOBUFFEREMPTY			0x80	// Command 47 reply when all moves are done
+#define ROBOTIMEOUT				26		// Reply timeout (1/512 sec, ~50 ms)
+#define ROBOPOWERMARK			654321	// Default duty acceleration set by init_MOTORS
 
+typedef struct {
+	char name;					// Profile letter (n, f, s)
+	uint32_t acceleration,		// counts/sec/sec
+	speed,						// counts/sec
+	deceleration;				// counts/sec/sec
+} MotionProfile;
+
+typedef struct {
+	char name;					// Move and report object (A, B, C uppercase is its controller)
+	uint8_t address,			// RoboClaw packet serial address (128-135)
+	channel;					// 1 (M1) or 2 (M2)
+	uint16_t countsPerMicron;	// Encoder counts per micron
+	char profile;				// Default motion profile (n, f, s, or a)
+	uint32_t maxAcceleration,	// Limit set by motor current and settling (counts/sec/sec)
+	maxSpeed;					// counts/sec
+	uint16_t framaddr;			// Where the encoder is saved in FRAM (4 bytes)
+} Axis;
+
+extern const Axis axes[NAXES];
 extern uint8_t timerSAVEENCODER, timeoutSAVEENCODER;
+extern int32_t lastEncoder[NAXES];
+extern uint8_t lastEncoderOK[NAXES];
 
 uint16_t crc16(uint8_t*, uint16_t);
+uint16_t crc16_continue(uint16_t, uint8_t*, uint16_t);
+uint8_t end_MOTOREncoder(int32_t*);
+uint8_t end_MOTORRead(uint8_t*);
+uint8_t get_AXIS(char);
 uint8_t getFRAM_MOTOREncoder(uint8_t, int32_t*);
+uint8_t get_MOTORBuffer(uint8_t, uint8_t*);
+uint8_t get_MOTORCurrent(uint8_t, uint16_t*);
+uint8_t get_MOTORProfile(uint8_t, char, int32_t, MotionProfile*);
 uint8_t get_MOTOREncoder(uint8_t, uint8_t, int32_t*);
 uint8_t get_MOTORFloat(uint8_t, uint8_t, float*);
 uint8_t get_MOTORInt32(uint8_t, uint8_t, uint32_t*);
+uint8_t get_MOTORMark(uint8_t, uint8_t*);
 uint8_t init_MOTORS(void);
 uint8_t motorsMoving(void);
 uint8_t move_MOTOR(uint8_t);
-uint8_t move_MOTORAbsolute(uint8_t, int32_t);
+uint8_t move_MOTORAbsolute(uint8_t, int32_t, MotionProfile*, uint8_t);
 uint8_t putFRAM_MOTOREncoder(uint8_t);
+void putFRAM_MOTORSeq(void);
+uint8_t putFRAM_MOTORValue(uint8_t, int32_t);
 uint8_t saveFRAM_MOTOREncoders(void);
+uint8_t saveFRAM_MOTORLast(void);
 uint8_t set_MOTOREncoder(uint8_t, int32_t);
+uint8_t set_MOTORMark(uint8_t);
+uint8_t start_MOTOREncoder(uint8_t, uint8_t);
+uint8_t start_MOTORRead(uint8_t, uint8_t, uint8_t);
 
 #endif
\ No newline at end of file
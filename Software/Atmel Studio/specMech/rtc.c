@@ -3,6 +3,38 @@
 #include "oled.h"
 #include "roboclaw.h"
 #include "rtc.h"
+#include "watch.h"
+#include "outbox.h"
+#include "wdt.h"
+#include "alarm.h"
+
+volatile uint32_t rtcTicks;		// 512 Hz ticks at the last RTC overflow
+
+/*----------------------------------------------------------------------
+uint32_t get_RTCTicks(void)
+	Time since power-up in RTC counts (1/512 sec). Used to timestamp
+	things that happen faster than once a second.
+----------------------------------------------------------------------*/
+uint32_t get_RTCTicks(void)
+{
+
+	uint8_t sreg;
+	uint16_t count;
+	uint32_t t;
+
+	sreg = SREG;
+	cli();
+	count = RTC.CNT;
+	t = rtcTicks;
+	if (RTC.INTFLAGS & RTC_OVF_bm) {	// Overflow hasn't been serviced yet
+		count = RTC.CNT;
+		t += RTC.PER + 1;
+	}
+	SREG = sreg;
+
+	return(t + count);
+
+}
 
 /*----------------------------------------------------------------------
 void init_RTC(uint16_t ticksRTC)
@@ -80,6 +112,7 @@ ISR(RTC_CNT_vect)
 {
 
 	RTC.INTFLAGS = RTC_OVF_bm;		// Clear interrupt flag
+	rtcTicks += RTC.PER + 1;		// Keep time in 1/512 sec units
 /*
 	if (timerOLED) {
 		if (timerOLED > timeoutOLED) {	// Display timeout
@@ -95,5 +128,11 @@ ISR(RTC_CNT_vect)
 	timerOLED++;					// Turn off the OLED display
 	toggle_LED;						// Blink the light
 	timerSAVEENCODER++;				// Save the motor encoder values
+	timerWATCH++;					// Report-on-change sampling
+	timerALARM++;					// Read the bump latch
+	if (timerHOST < 0xFFFF) {		// Time since the host was heard from
+		timerHOST++;
+	}
+	check_WDT();					// Feed the watchdog if no task overran
 
 }
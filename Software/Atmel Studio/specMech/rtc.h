@@ -1,6 +1,9 @@
 #ifndef RTCH
 #define RTCH
 
+extern volatile uint32_t rtcTicks;
+
+uint32_t get_RTCTicks(void);
 void init_RTC(uint16_t);
 
 #endif /* RTCH */
\ No newline at end of file
@@ -0,0 +1,501 @@
+/*------------------------------------------------------------------------------
+sentences.c
+	Generated by sentgen from Software/Host/sentences.def. Don't edit;
+	change the schema and run "make generate" in Software/Host.
+
+	The sentence formatters. Each one writes the sentence body (no $S<id>
+	or checksum, printLine adds those) into buf and returns its length.
+	Readings are turned into fixed point integers (to_FIXED) and written
+	with put_SNTINT, so printf's floating point support isn't needed.
+------------------------------------------------------------------------------*/
+
+#include "globals.h"
+#include <avr/pgmspace.h>
+#include "sentences.h"
+
+/*------------------------------------------------------------------------------
+uint8_t format_CMD(char *buf, const char *time, int32_t wait,
+	const char *command)
+	CMD,<time>,<wait>,ms,<command>
+------------------------------------------------------------------------------*/
+uint8_t format_CMD(char *buf, const char *time, int32_t wait,
+	const char *command)
+{
+
+	char *p;
+
+	p = buf;
+	p = put_SNTTEXT_P(p, PSTR("CMD,"));
+	p = put_SNTTEXT(p, time);
+	p = put_SNTTEXT_P(p, PSTR(","));
+	p = put_SNTINT(p, wait, 0, 0);
+	p = put_SNTTEXT_P(p, PSTR(",ms,"));
+	p = put_SNTTEXT(p, command);
+	*p = '\0';
+
+	return((uint8_t) (p - buf));
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t format_ENV(char *buf, const char *select, const char *time, float t0,
+	float h0, float t1, float h1, float t2, float h2, float t3,
+	const char *cid)
+	ENV[:<th>],<time>[,<t0>,C]@t[,<h0>,%]@h[,<t1>,C]@t[,<h1>,%]@h[,<t2>,C]@t[,<h2>,%]@h[,<t3>,C]@t,<cid>
+	select is NULL for every field, or the letters of the fields wanted.
+	A short sentence's type is marked with them (ENV:t).
+------------------------------------------------------------------------------*/
+uint8_t format_ENV(char *buf, const char *select, const char *time, float t0,
+	float h0, float t1, float h1, float t2, float h2, float t3,
+	const char *cid)
+{
+
+	char *p;
+
+	p = buf;
+	p = put_SNTTEXT_P(p, PSTR("ENV"));
+	if (select != NULL) {
+		*p++ = ':';
+		p = put_SNTTEXT(p, select);
+	}
+	p = put_SNTTEXT_P(p, PSTR(","));
+	p = put_SNTTEXT(p, time);
+	if (SNTWANT(select, 't')) {
+		p = put_SNTTEXT_P(p, PSTR(","));
+		p = put_SNTINT(p, to_FIXED(t0, 1), 3, 1);
+		p = put_SNTTEXT_P(p, PSTR(",C"));
+	}
+	if (SNTWANT(select, 'h')) {
+		p = put_SNTTEXT_P(p, PSTR(","));
+		p = put_SNTINT(p, to_FIXED(h0, 0), 1, 0);
+		p = put_SNTTEXT_P(p, PSTR(",%"));
+	}
+	if (SNTWANT(select, 't')) {
+		p = put_SNTTEXT_P(p, PSTR(","));
+		p = put_SNTINT(p, to_FIXED(t1, 1), 3, 1);
+		p = put_SNTTEXT_P(p, PSTR(",C"));
+	}
+	if (SNTWANT(select, 'h')) {
+		p = put_SNTTEXT_P(p, PSTR(","));
+		p = put_SNTINT(p, to_FIXED(h1, 0), 1, 0);
+		p = put_SNTTEXT_P(p, PSTR(",%"));
+	}
+	if (SNTWANT(select, 't')) {
+		p = put_SNTTEXT_P(p, PSTR(","));
+		p = put_SNTINT(p, to_FIXED(t2, 1), 3, 1);
+		p = put_SNTTEXT_P(p, PSTR(",C"));
+	}
+	if (SNTWANT(select, 'h')) {
+		p = put_SNTTEXT_P(p, PSTR(","));
+		p = put_SNTINT(p, to_FIXED(h2, 0), 1, 0);
+		p = put_SNTTEXT_P(p, PSTR(",%"));
+	}
+	if (SNTWANT(select, 't')) {
+		p = put_SNTTEXT_P(p, PSTR(","));
+		p = put_SNTINT(p, to_FIXED(t3, 1), 3, 1);
+		p = put_SNTTEXT_P(p, PSTR(",C"));
+	}
+	p = put_SNTTEXT_P(p, PSTR(","));
+	p = put_SNTTEXT(p, cid);
+	*p = '\0';
+
+	return((uint8_t) (p - buf));
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t format_ERR(char *buf, int32_t code, const char *text)
+	ERR,<code>[,<text>]
+------------------------------------------------------------------------------*/
+uint8_t format_ERR(char *buf, int32_t code, const char *text)
+{
+
+	char *p;
+
+	p = buf;
+	p = put_SNTTEXT_P(p, PSTR("ERR,"));
+	p = put_SNTINT(p, code, 0, 0);
+	if (text != NULL) {
+		p = put_SNTTEXT_P(p, PSTR(","));
+		p = put_SNTTEXT(p, text);
+	}
+	*p = '\0';
+
+	return((uint8_t) (p - buf));
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t format_EXP(char *buf, const char *time, int32_t late, int32_t wait,
+	const char *cid)
+	EXP,<time>,<late>,ms,<wait>,ms,<cid>
+------------------------------------------------------------------------------*/
+uint8_t format_EXP(char *buf, const char *time, int32_t late, int32_t wait,
+	const char *cid)
+{
+
+	char *p;
+
+	p = buf;
+	p = put_SNTTEXT_P(p, PSTR("EXP,"));
+	p = put_SNTTEXT(p, time);
+	p = put_SNTTEXT_P(p, PSTR(","));
+	p = put_SNTINT(p, late, 0, 0);
+	p = put_SNTTEXT_P(p, PSTR(",ms,"));
+	p = put_SNTINT(p, wait, 0, 0);
+	p = put_SNTTEXT_P(p, PSTR(",ms,"));
+	p = put_SNTTEXT(p, cid);
+	*p = '\0';
+
+	return((uint8_t) (p - buf));
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t format_MTR(char *buf, const char *select, const char *time, char axis,
+	int32_t position, int32_t speed, int32_t current, const char *cid)
+	MTR[:<psc>],<time>,<axis>[,<position>,microns]@p[,<speed>,microns/sec]@s[,<current>,mA]@c,<cid>
+	select is NULL for every field, or the letters of the fields wanted.
+	A short sentence's type is marked with them (MTR:p).
+------------------------------------------------------------------------------*/
+uint8_t format_MTR(char *buf, const char *select, const char *time, char axis,
+	int32_t position, int32_t speed, int32_t current, const char *cid)
+{
+
+	char *p;
+
+	p = buf;
+	p = put_SNTTEXT_P(p, PSTR("MTR"));
+	if (select != NULL) {
+		*p++ = ':';
+		p = put_SNTTEXT(p, select);
+	}
+	p = put_SNTTEXT_P(p, PSTR(","));
+	p = put_SNTTEXT(p, time);
+	p = put_SNTTEXT_P(p, PSTR(","));
+	*p++ = axis;
+	if (SNTWANT(select, 'p')) {
+		p = put_SNTTEXT_P(p, PSTR(","));
+		p = put_SNTINT(p, position, 0, 0);
+		p = put_SNTTEXT_P(p, PSTR(",microns"));
+	}
+	if (SNTWANT(select, 's')) {
+		p = put_SNTTEXT_P(p, PSTR(","));
+		p = put_SNTINT(p, speed, 0, 0);
+		p = put_SNTTEXT_P(p, PSTR(",microns/sec"));
+	}
+	if (SNTWANT(select, 'c')) {
+		p = put_SNTTEXT_P(p, PSTR(","));
+		p = put_SNTINT(p, current, 0, 0);
+		p = put_SNTTEXT_P(p, PSTR(",mA"));
+	}
+	p = put_SNTTEXT_P(p, PSTR(","));
+	p = put_SNTTEXT(p, cid);
+	*p = '\0';
+
+	return((uint8_t) (p - buf));
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t format_MTV(char *buf, const char *select, const char *time, char axis,
+	float volts, float temperature, const char *cid)
+	MTV[:<vt>],<time>,<axis>[,<volts>,V]@v[,<temperature>,C]@t,<cid>
+	select is NULL for every field, or the letters of the fields wanted.
+	A short sentence's type is marked with them (MTV:v).
+------------------------------------------------------------------------------*/
+uint8_t format_MTV(char *buf, const char *select, const char *time, char axis,
+	float volts, float temperature, const char *cid)
+{
+
+	char *p;
+
+	p = buf;
+	p = put_SNTTEXT_P(p, PSTR("MTV"));
+	if (select != NULL) {
+		*p++ = ':';
+		p = put_SNTTEXT(p, select);
+	}
+	p = put_SNTTEXT_P(p, PSTR(","));
+	p = put_SNTTEXT(p, time);
+	p = put_SNTTEXT_P(p, PSTR(","));
+	*p++ = axis;
+	if (SNTWANT(select, 'v')) {
+		p = put_SNTTEXT_P(p, PSTR(","));
+		p = put_SNTINT(p, to_FIXED(volts, 1), 3, 1);
+		p = put_SNTTEXT_P(p, PSTR(",V"));
+	}
+	if (SNTWANT(select, 't')) {
+		p = put_SNTTEXT_P(p, PSTR(","));
+		p = put_SNTINT(p, to_FIXED(temperature, 1), 3, 1);
+		p = put_SNTTEXT_P(p, PSTR(",C"));
+	}
+	p = put_SNTTEXT_P(p, PSTR(","));
+	p = put_SNTTEXT(p, cid);
+	*p = '\0';
+
+	return((uint8_t) (p - buf));
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t format_ORI(char *buf, const char *time, float x, float y, float z,
+	const char *cid)
+	ORI,<time>,<x>,<y>,<z>,<cid>
+------------------------------------------------------------------------------*/
+uint8_t format_ORI(char *buf, const char *time, float x, float y, float z,
+	const char *cid)
+{
+
+	char *p;
+
+	p = buf;
+	p = put_SNTTEXT_P(p, PSTR("ORI,"));
+	p = put_SNTTEXT(p, time);
+	p = put_SNTTEXT_P(p, PSTR(","));
+	p = put_SNTINT(p, to_FIXED(x, 1), 3, 1);
+	p = put_SNTTEXT_P(p, PSTR(","));
+	p = put_SNTINT(p, to_FIXED(y, 1), 3, 1);
+	p = put_SNTTEXT_P(p, PSTR(","));
+	p = put_SNTINT(p, to_FIXED(z, 1), 3, 1);
+	p = put_SNTTEXT_P(p, PSTR(","));
+	p = put_SNTTEXT(p, cid);
+	*p = '\0';
+
+	return((uint8_t) (p - buf));
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t format_PNU(char *buf, const char *time, char shutter, char left,
+	char right, char air, const char *cid)
+	PNU,<time>,<shutter>,shutter,<left>,left,<right>,right,<air>,air,<cid>
+------------------------------------------------------------------------------*/
+uint8_t format_PNU(char *buf, const char *time, char shutter, char left,
+	char right, char air, const char *cid)
+{
+
+	char *p;
+
+	p = buf;
+	p = put_SNTTEXT_P(p, PSTR("PNU,"));
+	p = put_SNTTEXT(p, time);
+	p = put_SNTTEXT_P(p, PSTR(","));
+	*p++ = shutter;
+	p = put_SNTTEXT_P(p, PSTR(",shutter,"));
+	*p++ = left;
+	p = put_SNTTEXT_P(p, PSTR(",left,"));
+	*p++ = right;
+	p = put_SNTTEXT_P(p, PSTR(",right,"));
+	*p++ = air;
+	p = put_SNTTEXT_P(p, PSTR(",air,"));
+	p = put_SNTTEXT(p, cid);
+	*p = '\0';
+
+	return((uint8_t) (p - buf));
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t format_QUE(char *buf, const char *time, int32_t commands,
+	int32_t expired, int32_t last, int32_t max, const char *cid)
+	QUE,<time>,<commands>,<expired>,<last>,ms,<max>,ms,<cid>
+------------------------------------------------------------------------------*/
+uint8_t format_QUE(char *buf, const char *time, int32_t commands,
+	int32_t expired, int32_t last, int32_t max, const char *cid)
+{
+
+	char *p;
+
+	p = buf;
+	p = put_SNTTEXT_P(p, PSTR("QUE,"));
+	p = put_SNTTEXT(p, time);
+	p = put_SNTTEXT_P(p, PSTR(","));
+	p = put_SNTINT(p, commands, 0, 0);
+	p = put_SNTTEXT_P(p, PSTR(","));
+	p = put_SNTINT(p, expired, 0, 0);
+	p = put_SNTTEXT_P(p, PSTR(","));
+	p = put_SNTINT(p, last, 0, 0);
+	p = put_SNTTEXT_P(p, PSTR(",ms,"));
+	p = put_SNTINT(p, max, 0, 0);
+	p = put_SNTTEXT_P(p, PSTR(",ms,"));
+	p = put_SNTTEXT(p, cid);
+	*p = '\0';
+
+	return((uint8_t) (p - buf));
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t format_TIM(char *buf, const char *time, const char *settime,
+	const char *boottime, const char *cid)
+	TIM,<time>,<settime>,set,<boottime>,boot,<cid>
+------------------------------------------------------------------------------*/
+uint8_t format_TIM(char *buf, const char *time, const char *settime,
+	const char *boottime, const char *cid)
+{
+
+	char *p;
+
+	p = buf;
+	p = put_SNTTEXT_P(p, PSTR("TIM,"));
+	p = put_SNTTEXT(p, time);
+	p = put_SNTTEXT_P(p, PSTR(","));
+	p = put_SNTTEXT(p, settime);
+	p = put_SNTTEXT_P(p, PSTR(",set,"));
+	p = put_SNTTEXT(p, boottime);
+	p = put_SNTTEXT_P(p, PSTR(",boot,"));
+	p = put_SNTTEXT(p, cid);
+	*p = '\0';
+
+	return((uint8_t) (p - buf));
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t format_VAC(char *buf, const char *select, const char *time, float red,
+	float blue, const char *cid)
+	VAC[:<rb>],<time>[,<red>,redvac]@r[,<blue>,bluevac]@b,<cid>
+	select is NULL for every field, or the letters of the fields wanted.
+	A short sentence's type is marked with them (VAC:r).
+------------------------------------------------------------------------------*/
+uint8_t format_VAC(char *buf, const char *select, const char *time, float red,
+	float blue, const char *cid)
+{
+
+	char *p;
+
+	p = buf;
+	p = put_SNTTEXT_P(p, PSTR("VAC"));
+	if (select != NULL) {
+		*p++ = ':';
+		p = put_SNTTEXT(p, select);
+	}
+	p = put_SNTTEXT_P(p, PSTR(","));
+	p = put_SNTTEXT(p, time);
+	if (SNTWANT(select, 'r')) {
+		p = put_SNTTEXT_P(p, PSTR(","));
+		p = put_SNTINT(p, to_FIXED(red, 2), 5, 2);
+		p = put_SNTTEXT_P(p, PSTR(",redvac"));
+	}
+	if (SNTWANT(select, 'b')) {
+		p = put_SNTTEXT_P(p, PSTR(","));
+		p = put_SNTINT(p, to_FIXED(blue, 2), 5, 2);
+		p = put_SNTTEXT_P(p, PSTR(",bluevac"));
+	}
+	p = put_SNTTEXT_P(p, PSTR(","));
+	p = put_SNTTEXT(p, cid);
+	*p = '\0';
+
+	return((uint8_t) (p - buf));
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t format_VER(char *buf, const char *time, const char *version,
+	const char *cid)
+	VER,<time>,<version>,<cid>
+------------------------------------------------------------------------------*/
+uint8_t format_VER(char *buf, const char *time, const char *version,
+	const char *cid)
+{
+
+	char *p;
+
+	p = buf;
+	p = put_SNTTEXT_P(p, PSTR("VER,"));
+	p = put_SNTTEXT(p, time);
+	p = put_SNTTEXT_P(p, PSTR(","));
+	p = put_SNTTEXT(p, version);
+	p = put_SNTTEXT_P(p, PSTR(","));
+	p = put_SNTTEXT(p, cid);
+	*p = '\0';
+
+	return((uint8_t) (p - buf));
+
+}
+
+/*------------------------------------------------------------------------------
+char *put_SNTINT(char *p, int32_t value, uint8_t width, uint8_t decimals)
+	Write an integer, or a fixed point number with the decimal point put in
+	decimals digits from the right, padded with spaces to at least width
+	characters. Returns the end of what was written.
+------------------------------------------------------------------------------*/
+char *put_SNTINT(char *p, int32_t value, uint8_t width, uint8_t decimals)
+{
+
+	char digits[12];
+	uint8_t n, len;
+	uint32_t u;
+
+	u = (value < 0) ? -((uint32_t) value) : (uint32_t) value;
+	n = 0;
+	do {								// At least one digit before the point
+		digits[n++] = '0' + (u % 10);
+		u /= 10;
+	} while ((u != 0) || (n <= decimals));
+
+	len = n + (decimals ? 1 : 0) + ((value < 0) ? 1 : 0);
+	for (; len < width; len++) {
+		*p++ = ' ';
+	}
+	if (value < 0) {
+		*p++ = '-';
+	}
+	while (n > 0) {
+		*p++ = digits[--n];
+		if (decimals && (n == decimals)) {
+			*p++ = '.';
+		}
+	}
+
+	return(p);
+
+}
+
+/*------------------------------------------------------------------------------
+char *put_SNTTEXT(char *p, const char *text)
+	Copy a string. Returns the end of what was written.
+------------------------------------------------------------------------------*/
+char *put_SNTTEXT(char *p, const char *text)
+{
+
+	while (*text != '\0') {
+		*p++ = *text++;
+	}
+
+	return(p);
+
+}
+
+/*------------------------------------------------------------------------------
+char *put_SNTTEXT_P(char *p, const char *text)
+	Copy a string from flash. Returns the end of what was written.
+------------------------------------------------------------------------------*/
+char *put_SNTTEXT_P(char *p, const char *text)
+{
+
+	char c;
+
+	while ((c = pgm_read_byte(text++)) != '\0') {
+		*p++ = c;
+	}
+
+	return(p);
+
+}
+
+/*------------------------------------------------------------------------------
+int32_t to_FIXED(float value, uint8_t decimals)
+	A reading as a fixed point integer: value times 10^decimals, rounded
+------------------------------------------------------------------------------*/
+int32_t to_FIXED(float value, uint8_t decimals)
+{
+
+	while (decimals-- > 0) {
+		value *= 10.0;
+	}
+
+	return((int32_t) ((value < 0.0) ? (value - 0.5) : (value + 0.5)));
+
+}
@@ -0,0 +1,35 @@
+/*------------------------------------------------------------------------------
+sentences.h
+	Generated by sentgen from Software/Host/sentences.def. Don't edit;
+	change the schema and run "make generate" in Software/Host.
+------------------------------------------------------------------------------*/
+#ifndef SENTENCESH
+#define SENTENCESH
+
+// Is field c in a short report's select letters (NULL is every field)?
+#define SNTWANT(select, c)	(((select) == NULL) || (strchr((select), (c)) != NULL))
+
+// Select letters for each sentence that has short forms
+#define SNTSELECT_ENV	"th"
+#define SNTSELECT_MTR	"psc"
+#define SNTSELECT_MTV	"vt"
+#define SNTSELECT_VAC	"rb"
+
+uint8_t format_CMD(char*, const char*, int32_t, const char*);
+uint8_t format_ENV(char*, const char*, const char*, float, float, float, float, float, float, float, const char*);
+uint8_t format_ERR(char*, int32_t, const char*);
+uint8_t format_EXP(char*, const char*, int32_t, int32_t, const char*);
+uint8_t format_MTR(char*, const char*, const char*, char, int32_t, int32_t, int32_t, const char*);
+uint8_t format_MTV(char*, const char*, const char*, char, float, float, const char*);
+uint8_t format_ORI(char*, const char*, float, float, float, const char*);
+uint8_t format_PNU(char*, const char*, char, char, char, char, const char*);
+uint8_t format_QUE(char*, const char*, int32_t, int32_t, int32_t, int32_t, const char*);
+uint8_t format_TIM(char*, const char*, const char*, const char*, const char*);
+uint8_t format_VAC(char*, const char*, const char*, float, float, const char*);
+uint8_t format_VER(char*, const char*, const char*, const char*);
+char *put_SNTINT(char*, int32_t, uint8_t, uint8_t);
+char *put_SNTTEXT(char*, const char*);
+char *put_SNTTEXT_P(char*, const char*);
+int32_t to_FIXED(float, uint8_t);
+
+#endif
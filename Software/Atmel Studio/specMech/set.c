@@ -4,6 +4,11 @@
 #include "ds3231.h"
 #include "commands.h"
 #include "set.h"
+#include "trajectory.h"
+#include "pneu.h"
+#include "alarm.h"
+#include "usart.h"
+#include "usage.h"
 
 /*------------------------------------------------------------------------------
 uint8_t set (char *ptr)
@@ -34,6 +39,54 @@ uint8_t set(uint8_t cstack)
 //			write_FRAM(FRAMTWIADDR, SETTIMEFRAM, (uint8_t*) pcmd[cstack].cvalue);
 			break;
 
+		case 'j':				// Trajectory recorder (sjon or sjoff)
+			if (strcmp(pcmd[cstack].cvalue, "on") == 0) {
+				arm_TRAJECTORY(YES);
+			} else if (strcmp(pcmd[cstack].cvalue, "off") == 0) {
+				arm_TRAJECTORY(NO);
+			} else {
+				printError(ERR_SETVALUE, "set: j must be on or off");
+				return(ERROR);
+			}
+			break;
+
+		case 'h':				// Valve holding, sh<mech><e|r> (e.g. shsr)
+			if ((strlen(pcmd[cstack].cvalue) != 2) ||
+				(set_PNEUHOLD(pcmd[cstack].cvalue[0], pcmd[cstack].cvalue[1]) == ERROR)) {
+				printError(ERR_SETVALUE, "set: h must be <s|l|r|b><e|r>");
+				return(ERROR);
+			}
+			break;
+
+		case 'a':				// Alarm limits (sat<low>,<high> or sab<cm/s/s>)
+			if (set_ALARM(pcmd[cstack].cvalue) == ERROR) {
+				return(ERROR);
+			}
+			break;
+
+		case 'l':				// Link health counters back to zero (sl)
+			reset_LINK();
+			break;
+
+		case 'u':				// Zero a replaced mechanism's usage (su<s|l|r|axis>)
+			if ((strlen(pcmd[cstack].cvalue) != 1) ||
+				(reset_USAGE(pcmd[cstack].cvalue[0]) == ERROR)) {
+				printError(ERR_SETVALUE, "set: u must be s, l, r, or an axis");
+				return(ERROR);
+			}
+			break;
+
+		case 's':				// Session profile (ssmachine or ssinteractive)
+			if (strcmp(pcmd[cstack].cvalue, "machine") == 0) {
+				sessionMode = SESSIONMACHINE;
+			} else if (strcmp(pcmd[cstack].cvalue, "interactive") == 0) {
+				sessionMode = SESSIONINTERACTIVE;
+			} else {
+				printError(ERR_SETVALUE, "set: s must be machine or interactive");
+				return(ERROR);
+			}
+			break;
+
 		default:
 			printError(ERR_SET, "set what?");
 			return(ERROR);
@@ -0,0 +1,221 @@
+/*------------------------------------------------------------------------------
+snapshot.c
+	Exposure snapshots. The sensors and collimator motor positions are read
+	back-to-back at every shutter open and close, whether specMech commanded
+	the move or the GMR sensors saw it happen. The snapshots are kept in an
+	FRAM ring (two per exposure) for the FITS headers.
+------------------------------------------------------------------------------*/
+
+#include "globals.h"
+#include "errors.h"
+#include "commands.h"
+#include "ds3231.h"
+#include "fram.h"
+#include "pneu.h"
+#include "report.h"
+#include "roboclaw.h"
+#include "usart.h"
+#include "snapshot.h"
+
+uint16_t snapExposure;				// Current exposure number
+char snapEdge;						// Last shutter edge recorded ('o' or 'c')
+volatile uint8_t pneuChanged;		// Set by the PORTD (GMR sensor) interrupt
+
+/*------------------------------------------------------------------------------
+void check_SNAPSHOT(void)
+	Called from the main loop after the GMR sensors interrupt. If the shutter
+	has finished opening or closing and no snapshot has been taken for that
+	edge yet (someone moved it by hand or with the valves directly), take one.
+------------------------------------------------------------------------------*/
+void check_SNAPSHOT(void)
+{
+
+	char shutter, left, right, air;
+
+	read_PNEUSensors(&shutter, &left, &right, &air);
+	if (((shutter == 'o') || (shutter == 'c')) && (shutter != snapEdge)) {
+		take_SNAPSHOT(shutter, 'd', "");
+	}
+
+}
+
+/*------------------------------------------------------------------------------
+void init_SNAPSHOT(void)
+	Find the latest exposure number in FRAM and note which way the shutter is
+	now so the first sensor interrupt doesn't look like a shutter move.
+------------------------------------------------------------------------------*/
+void init_SNAPSHOT(void)
+{
+
+	uint8_t i;
+	char shutter, left, right, air;
+	Snapshot snap;
+
+	snapExposure = 0;
+	for (i = 0; i < SNAPSLOTS; i++) {
+		if (read_FRAM(FRAMTWIADDR, SNAPFRAMADDR + (i * sizeof(Snapshot)),
+			(uint8_t*) &snap, 3) == ERROR) {
+			break;
+		}
+		if ((snap.valid == SNAPVALID) && (snap.exposure > snapExposure)) {
+			snapExposure = snap.exposure;
+		}
+	}
+
+	read_PNEUSensors(&shutter, &left, &right, &air);
+	snapEdge = shutter;
+	pneuChanged = NO;
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t report_SNAPSHOT(uint8_t cstack)
+	Send stored snapshots as SNP sentences
+
+	Input:
+		cstack - the pcmd entry holding the report command. The value picks
+			the snapshots:
+			rx - both snapshots of the latest exposure
+			rx<n> - both snapshots (open and close) of exposure n
+			rx=<id> - snapshots triggered by the command with ID <id>
+
+	Output:
+		SNP,<snaptime>,<exposure>,<edge>,<source>,<trigger ID>,
+			t0,h0,t1,h1,t2,h2,t3,redvac,bluevac,x,y,z,a,b,c,
+			shutter,left,right,air,<ID>
+
+	Returns:
+		ERROR if nothing matched or FRAM failed, NOERROR otherwise
+------------------------------------------------------------------------------*/
+uint8_t report_SNAPSHOT(uint8_t cstack)
+{
+
+	char outbuf[BUFSIZE], *value;
+	const char format_SNP[] = "SNP,%s,%u,%c,%c,%s,%3.1f,%1.0f,%3.1f,%1.0f,%3.1f,%1.0f,%3.1f,%5.2f,%5.2f,%3.1f,%3.1f,%3.1f,%ld,%ld,%ld,%c,%c,%c,%c,%s";
+	uint8_t i, found;
+	uint16_t exposure;
+	Snapshot snap;
+
+	value = pcmd[cstack].cvalue;
+	exposure = (value[0] == '\0') ? snapExposure : atol(value);
+	found = NO;
+
+	for (i = 0; i < SNAPSLOTS; i++) {
+		if (read_FRAM(FRAMTWIADDR, SNAPFRAMADDR + (i * sizeof(Snapshot)),
+			(uint8_t*) &snap, sizeof(Snapshot)) == ERROR) {
+			printError(ERR_SNAPFRAM, "snapshot: FRAM read");
+			return(ERROR);
+		}
+		if (snap.valid != SNAPVALID) {
+			continue;
+		}
+		if (value[0] == '=') {
+			if (strcmp(&value[1], snap.cid) != 0) {
+				continue;
+			}
+		} else if (snap.exposure != exposure) {
+			continue;
+		}
+		snap.time[ISOTIMELEN-1] = '\0';
+		snap.cid[CIDSIZE-1] = '\0';
+		sprintf(outbuf, format_SNP, snap.time, snap.exposure, snap.edge,
+			snap.source, snap.cid, snap.env[0], snap.env[1], snap.env[2],
+			snap.env[3], snap.env[4], snap.env[5], snap.env[6], snap.vac[0],
+			snap.vac[1], snap.ori[0], snap.ori[1], snap.ori[2], snap.position[0],
+			snap.position[1], snap.position[2], snap.pneu[0], snap.pneu[1],
+			snap.pneu[2], snap.pneu[3], pcmd[cstack].cid);
+		printLine(outbuf);
+		found = YES;
+	}
+
+	if (!found) {
+		printError(ERR_SNAPNONE, "snapshot: none found");
+		return(ERROR);
+	}
+
+	return(NOERROR);
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t take_SNAPSHOT(char edge, char source, char *cid)
+	Read everything for a FITS header as close together in time as possible
+	and save it in FRAM. Opening the shutter starts a new exposure.
+
+	Input:
+		edge - 'o' shutter opening, 'c' shutter closing
+		source - 'c' if commanded, 'd' if detected by the sensors
+		cid - command ID of the open or close command ("" if detected)
+
+	Returns:
+		ERROR if the FRAM write failed, NOERROR otherwise. Readings that fail
+		are saved as BADFLOAT (or 0x7FFFFFFF/ROBOCOUNTSPERMICRON for motors).
+------------------------------------------------------------------------------*/
+uint8_t take_SNAPSHOT(char edge, char source, char *cid)
+{
+
+	uint8_t i, j, started, slot, oldsquelch;
+	int32_t encoderValue;
+	float fields[REPORTFIELDS];
+	Snapshot snap;
+
+	oldsquelch = squelchErrors;		// Missing values are flagged in the record
+	squelchErrors = YES;
+
+	if (edge == 'o') {
+		snapExposure++;
+	}
+	snapEdge = edge;
+
+	snap.valid = SNAPVALID;
+	snap.exposure = snapExposure;
+	snap.edge = edge;
+	snap.source = source;
+	strncpy(snap.cid, cid, CIDSIZE-1);
+	snap.cid[CIDSIZE-1] = '\0';
+
+	get_time(snap.time);			// Fastest reads first
+
+	// Each encoder read (collimator axes a, b, c) goes out on USART1 and its
+	// reply comes in by interrupt while a TWI sensor is being read, so the
+	// two buses work at the same time.
+	for (i = 0; i < 3; i++) {
+		started = ((i < NAXES) &&
+			(start_MOTOREncoder(i, ROBOREADENCODERCOUNT) == NOERROR));
+		switch (i) {
+			case 0:
+				get_REPORT('p', NULL, fields);
+				for (j = 0; j < 4; j++) {
+					snap.pneu[j] = (char) fields[j];
+				}
+				break;
+
+			case 1:
+				get_REPORT('o', NULL, snap.ori);
+				break;
+
+			default:
+				get_REPORT('v', NULL, snap.vac);
+				break;
+		}
+		if (!started || (end_MOTOREncoder(&encoderValue) == ERROR)) {
+			encoderValue = 0x7FFFFFFF;
+		}
+		if (i < NAXES) {
+			snap.position[i] = encoderValue/(int32_t) axes[i].countsPerMicron;
+		}
+	}
+	get_REPORT('e', NULL, snap.env);
+
+	squelchErrors = oldsquelch;
+
+	slot = ((snapExposure * 2) + (edge == 'c')) % SNAPSLOTS;
+	if (write_FRAM(FRAMTWIADDR, SNAPFRAMADDR + (slot * sizeof(Snapshot)),
+		(uint8_t*) &snap, sizeof(Snapshot)) == ERROR) {
+		printError(ERR_SNAPFRAM, "snapshot: FRAM write");
+		return(ERROR);
+	}
+
+	return(NOERROR);
+
+}
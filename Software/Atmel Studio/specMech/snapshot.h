@@ -0,0 +1,31 @@
+#ifndef SNAPSHOTH
+#define SNAPSHOTH
+
+#include "commands.h"
+#include "fram.h"
+
+#define SNAPSLOTS		16		// Snapshots kept in FRAM (two per exposure)
+#define SNAPVALID		(0xA5)	// Marks a snapshot record that has been written
+
+typedef struct {
+	uint8_t valid;				// SNAPVALID once the record is written
+	uint16_t exposure;			// Exposure number (counts shutter opens)
+	char edge,					// 'o' shutter open, 'c' shutter close
+	source,						// 'c' commanded, 'd' detected by the GMR sensors
+	cid[CIDSIZE],				// Command ID of the open or close command
+	time[ISOTIMELEN];			// When the snapshot was taken
+	float env[7],				// Temperature & humidity (as in ENV)
+	vac[2],						// Red and blue ion pumps
+	ori[3];						// Orientation x, y, z
+	int32_t position[3];		// Collimator motors a, b, c (microns)
+	char pneu[4];				// shutter, left, right, air
+} Snapshot;
+
+extern volatile uint8_t pneuChanged;
+
+void check_SNAPSHOT(void);
+void init_SNAPSHOT(void);
+uint8_t report_SNAPSHOT(uint8_t);
+uint8_t take_SNAPSHOT(char, char, char*);
+
+#endif
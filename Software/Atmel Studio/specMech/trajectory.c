@@ -0,0 +1,282 @@
+/*------------------------------------------------------------------------------
+trajectory.c
+	Collimator move recorder. When armed (sjon) every move is sampled as fast
+	as the RoboClaw link allows: position, speed, and current with a 1/512 sec
+	timestamp. Samples go into a small RAM ring and are written to FRAM in
+	blocks so a long move doesn't run out of RAM. The rj command dumps the
+	last trajectory as binary frames on the TXBULK output queue, so replies
+	and events keep going out while it runs.
+------------------------------------------------------------------------------*/
+
+#include "globals.h"
+#include "errors.h"
+#include "commands.h"
+#include "ds3231.h"
+#include "fram.h"
+#include "nmea.h"
+#include "roboclaw.h"
+#include "rtc.h"
+#include "specID.h"
+#include "usart.h"
+#include "trajectory.h"
+#include "waypoint.h"
+
+uint8_t trjArmed, trjRecording;		// Recorder armed, move being recorded
+uint8_t trjAxis, trjStill, trjMoved, trjTruncated;
+uint8_t trjDumping;					// rj frames still to send
+uint16_t trjCount, trjFlushed;		// Samples taken, samples in FRAM
+uint16_t trjDumped, trjCRC;			// Samples sent by rj, their crc16
+char trjCID[CIDSIZE];				// rj command ID
+uint32_t trjStart;					// RTC ticks when the move started
+int32_t trjTarget;					// Commanded position (encoder counts)
+MotionProfile trjProfile;			// Profile sent with the move
+char trjTime[ISOTIMELEN];			// When the move started
+TrjSample trjbuf[TRJRAMSAMPLES];
+
+/*------------------------------------------------------------------------------
+void arm_TRAJECTORY(uint8_t arm)
+	Turn the recorder on (YES) or off (NO). Turning it off stops a recording
+	in progress; what was recorded so far can still be dumped.
+------------------------------------------------------------------------------*/
+void arm_TRAJECTORY(uint8_t arm)
+{
+
+	trjArmed = arm;
+	if (!arm && trjRecording) {
+		stop_TRAJECTORY();
+	}
+
+}
+
+/*------------------------------------------------------------------------------
+void dump_TRAJECTORY(void)
+	Send the next rj frame. Called from the main loop while trjDumping is
+	set. A frame only goes out when it fits in the TXBULK queue, so this
+	never waits on the serial port. Each data frame is a sentence followed
+	by its binary samples
+		TRB,<byte offset>,<nbytes>,<ID>
+	and the dump ends with
+		TRJ,<time>,end,<crc16 in hex>,<ID>
+	A FRAM error ends the dump early; the short byte count and the crc tell
+	the host.
+------------------------------------------------------------------------------*/
+void dump_TRAJECTORY(void)
+{
+
+	char frame[BUFSIZE], currenttime[20];
+	const char format_TRB[] = "$S%dTRB,%u,%u,%s";
+	const char format_TRE[] = "$S%dTRJ,%s,end,%04X,%s";
+	uint8_t nsamples, nbytes, len;
+
+	if (trjDumped < trjCount) {
+		nsamples = ((trjCount - trjDumped) > TRJFLUSH) ? TRJFLUSH : (trjCount - trjDumped);
+		nbytes = nsamples * sizeof(TrjSample);
+		sprintf(frame, format_TRB, get_SPECID, trjDumped * sizeof(TrjSample),
+			nbytes, trjCID);
+		checksum_NMEA(frame);
+		len = strlen(frame);
+		if (room_USART0(TXBULK) < (len + nbytes)) {
+			return;						// Wait for the queue to drain
+		}
+		if (read_FRAM(FRAMTWIADDR, TRJFRAMADDR + (trjDumped * sizeof(TrjSample)),
+			(uint8_t*) &frame[len], nbytes) == ERROR) {
+			trjDumped = trjCount;		// Give up, send the trailer
+			return;
+		}
+		trjCRC = crc16_continue(trjCRC, (uint8_t*) &frame[len], nbytes);
+		queue_USART0(TXBULK, (uint8_t*) frame, len + nbytes);
+		trjDumped += nsamples;
+		return;
+	}
+
+	get_time(currenttime);
+	sprintf(frame, format_TRE, get_SPECID, currenttime, trjCRC, trjCID);
+	checksum_NMEA(frame);
+	if (room_USART0(TXBULK) < strlen(frame)) {
+		return;
+	}
+	queue_USART0(TXBULK, (uint8_t*) frame, strlen(frame));
+	trjDumping = NO;
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t flush_TRAJECTORY(void)
+	Write the samples waiting in the RAM ring to FRAM, in pieces that stop
+	at the end of the ring. If a write fails the recording ends there: the
+	samples not written are dropped and it is marked truncated, so
+	trjCount never gets more than a ring ahead of trjFlushed.
+------------------------------------------------------------------------------*/
+uint8_t flush_TRAJECTORY(void)
+{
+
+	uint8_t first, nsamples;
+
+	while (trjFlushed < trjCount) {
+		first = trjFlushed % TRJRAMSAMPLES;
+		nsamples = ((trjCount - trjFlushed) > (TRJRAMSAMPLES - first)) ?
+			(TRJRAMSAMPLES - first) : (trjCount - trjFlushed);
+		if (write_FRAM(FRAMTWIADDR, TRJFRAMADDR + (trjFlushed * sizeof(TrjSample)),
+			(uint8_t*) &trjbuf[first], nsamples * sizeof(TrjSample)) == ERROR) {
+			trjCount = trjFlushed;
+			trjTruncated = YES;
+			trjRecording = NO;
+			return(ERROR);
+		}
+		trjFlushed += nsamples;
+	}
+
+	return(NOERROR);
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t report_TRAJECTORY(uint8_t cstack)
+	Start dumping the last recorded trajectory
+
+	Input:
+		cstack - the pcmd entry holding the rj command
+
+	Output:
+		A header sentence with the reply
+			TRJ,<start time>,<motor>,<nsamples>,<nbytes>,<target>,<counts/micron>,
+				<profile>,<acceleration>,<speed>,<deceleration>,<truncated>,<ID>
+		and after the prompt, from dump_TRAJECTORY, the nbytes of binary data
+		in TRB frames, nsamples TrjSample records (12 bytes each,
+		little-endian: uint16 time, int32 position, int32 speed, int16
+		current), and then a trailer sentence with the crc16 (same as the
+		RoboClaw CRC) of all the binary data
+			TRJ,<time>,end,<crc16 in hex>,<ID>
+
+	Returns:
+		ERROR if a move is being recorded or dumped, NOERROR otherwise
+------------------------------------------------------------------------------*/
+uint8_t report_TRAJECTORY(uint8_t cstack)
+{
+
+	char outbuf[BUFSIZE];
+	const char format_TRJ[] = "TRJ,%s,%c,%u,%u,%ld,%d,%c,%lu,%lu,%lu,%c,%s";
+
+	if (trjRecording) {
+		printError(ERR_TRJBUSY, "trajectory: still recording");
+		return(ERROR);
+	}
+
+	if (trjDumping) {
+		printError(ERR_TRJBUSY, "trajectory: still dumping");
+		return(ERROR);
+	}
+
+	if (trjTime[0] == '\0') {
+		printError(ERR_TRJNONE, "trajectory: nothing recorded");
+		return(ERROR);
+	}
+
+	sprintf(outbuf, format_TRJ, trjTime, axes[trjAxis].name, trjCount,
+		trjCount * sizeof(TrjSample), trjTarget, axes[trjAxis].countsPerMicron,
+		trjProfile.name, trjProfile.acceleration, trjProfile.speed,
+		trjProfile.deceleration, trjTruncated ? 'y' : 'n', pcmd[cstack].cid);
+	printLine(outbuf);
+
+	strcpy(trjCID, pcmd[cstack].cid);
+	trjDumped = 0;
+	trjCRC = 0;
+	trjDumping = YES;
+
+	return(NOERROR);
+
+}
+
+/*------------------------------------------------------------------------------
+void sample_TRAJECTORY(void)
+	Take one sample of the moving motor. Called from the main loop while
+	trjRecording is set, so each pass through the loop gets a sample and
+	commands still run in between. The recording ends when the motor has
+	stopped for TRJSTILL samples (after the last waypoint), never starts
+	moving, or FRAM fills up.
+------------------------------------------------------------------------------*/
+void sample_TRAJECTORY(void)
+{
+
+	uint16_t current;
+	TrjSample *sample;
+
+	sample = &trjbuf[trjCount % TRJRAMSAMPLES];
+	sample->time = (uint16_t) (get_RTCTicks() - trjStart);
+	if (get_MOTOREncoder(trjAxis, ROBOREADENCODERCOUNT, &sample->position) == ERROR) {
+		sample->position = 0x7FFFFFFF;
+	}
+	if (get_MOTOREncoder(trjAxis, ROBOREADENCODERSPEED, &sample->speed) == ERROR) {
+		sample->speed = 0x7FFFFFFF;
+	}
+	if (get_MOTORCurrent(trjAxis, &current) == ERROR) {
+		current = 0x7FFF;
+	}
+	sample->current = (int16_t) current;
+	trjCount++;
+
+	if (sample->speed == 0) {
+		trjStill++;
+	} else {
+		trjStill = 0;
+		trjMoved = YES;
+	}
+
+	if ((trjCount - trjFlushed) >= TRJFLUSH) {
+		flush_TRAJECTORY();
+	}
+
+	if (trjCount >= TRJFRAMSAMPLES) {
+		trjTruncated = YES;
+		stop_TRAJECTORY();
+	} else if (trjMoved && (trjStill >= TRJSTILL) && !waypointsActive(trjAxis)) {
+		stop_TRAJECTORY();
+	} else if (!trjMoved && ((get_RTCTicks() - trjStart) > TRJSTARTTIMEOUT)) {
+		stop_TRAJECTORY();
+	}
+
+}
+
+/*------------------------------------------------------------------------------
+void start_TRAJECTORY(uint8_t axis, int32_t target, MotionProfile *profile)
+	Start recording a move if the recorder is armed. A new move replaces the
+	last trajectory, but not while rj is still sending it (the move isn't
+	recorded).
+
+	Input:
+		axis - index into axes[]
+		target - the commanded position in encoder counts
+		profile - the motion profile sent with the move
+------------------------------------------------------------------------------*/
+void start_TRAJECTORY(uint8_t axis, int32_t target, MotionProfile *profile)
+{
+
+	if (!trjArmed || trjDumping) {
+		return;
+	}
+
+	trjAxis = axis;
+	trjTarget = target;
+	trjProfile = *profile;
+	trjCount = 0;
+	trjFlushed = 0;
+	trjStill = 0;
+	trjMoved = NO;
+	trjTruncated = NO;
+	get_time(trjTime);
+	trjStart = get_RTCTicks();
+	trjRecording = YES;
+
+}
+
+/*------------------------------------------------------------------------------
+void stop_TRAJECTORY(void)
+	End the recording and write what's left in RAM to FRAM
+------------------------------------------------------------------------------*/
+void stop_TRAJECTORY(void)
+{
+
+	flush_TRAJECTORY();
+	trjRecording = NO;
+
+}
@@ -0,0 +1,29 @@
+#ifndef TRAJECTORYH
+#define TRAJECTORYH
+
+#include "roboclaw.h"
+
+#define TRJRAMSAMPLES	16		// RAM ring size (samples)
+#define TRJFLUSH		8		// Write to FRAM when this many samples are waiting
+#define TRJFRAMSAMPLES	1536	// Most samples kept in FRAM (12 bytes each)
+#define TRJSTILL		3		// Zero-speed samples in a row that end a move
+#define TRJSTARTTIMEOUT	512		// Give up if the motor hasn't moved (1/512 sec)
+
+typedef struct {
+	uint16_t time;				// RTC ticks (1/512 sec) since the move started (wraps at 128 sec)
+	int32_t position,			// Encoder counts
+	speed;						// Encoder counts/sec
+	int16_t current;			// Motor current (10 mA units)
+} TrjSample;
+
+extern uint8_t trjArmed, trjRecording, trjDumping;
+
+void arm_TRAJECTORY(uint8_t);
+void dump_TRAJECTORY(void);
+uint8_t flush_TRAJECTORY(void);
+uint8_t report_TRAJECTORY(uint8_t);
+void sample_TRAJECTORY(void);
+void start_TRAJECTORY(uint8_t, int32_t, MotionProfile*);
+void stop_TRAJECTORY(void);
+
+#endif
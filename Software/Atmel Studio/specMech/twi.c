@@ -2,6 +2,9 @@
 #include "timers.h"
 #include "errors.h"
 #include "twi.h"
+#include "wdt.h"
+#include "bus.h"
+#include "bod.h"
 
 /*------------------------------------------------------------------------------
 void init_TWI(void)
@@ -49,13 +52,21 @@ void init_TWI(void)
 uint8_t read_TWI(void)
 	Read one byte then send an ACK.
 	Use readlast_TWI() to read the last byte and send a NACK.
+
+	The TWI waits here and in start_TWI and write_TWI give up as soon as
+	powerFail is set (0 or ERROR), so whatever task is running gets back
+	to the main loop and save_POWERFAIL without waiting out a timeout.
 ------------------------------------------------------------------------------*/
 uint8_t read_TWI(void)
 {
 
 	uint8_t data;
 
+	TRACE_WDT(TRCTWIREAD);
 	while (!(TWI0.MSTATUS & TWI_RIF_bm)) {		// Wait xfer to complete
+		if (powerFail) {						// Give way to save_POWERFAIL
+			return(0);
+		}
 		asm("nop");								// Should set timer here
 	}
 
@@ -76,7 +87,11 @@ uint8_t readlast_TWI(void)
 
 	uint8_t data;
 
+	TRACE_WDT(TRCTWIREAD);
 	while (!(TWI0.MSTATUS & TWI_RIF_bm)) {		// Wait for xfer to complete
+		if (powerFail) {						// Give way to save_POWERFAIL
+			return(0);
+		}
 		asm("nop");
 	}
 
@@ -115,6 +130,8 @@ Notes:
 uint8_t start_TWI(uint8_t addr, uint8_t rw)
 {
 
+	claim_BUS(BUSTWI);						// Repeated starts keep it
+
 	if (rw == TWIREAD) {
 //		addr = ((addr << 1) | 0x01);
 		TWI0.MADDR = ((addr << 1) | 0x01);
@@ -128,7 +145,7 @@ uint8_t start_TWI(uint8_t addr, uint8_t rw)
 
 	start_TCB0(1);
 	while (!(TWI0.MSTATUS & (TWI_WIF_bm | TWI_RIF_bm))) {
-		if (ticks > 10) {
+		if ((ticks > 10) || powerFail) {		// Or give way to save_POWERFAIL
 			stop_TCB0();
 			return(ERROR);
 		}
@@ -152,12 +169,13 @@ uint8_t start_TWI(uint8_t addr, uint8_t rw)
 /*------------------------------------------------------------------------------
 void stop_TWI(void)
 	Puts a stop condition on the TWI bus. The TWI_MCMD_STOP_gc bit in MCTRLB
-	is a strobe action.
+	is a strobe action. The bus is released (see bus.c).
 ------------------------------------------------------------------------------*/
 void stop_TWI(void)
 {
 
 	TWI0.MCTRLB = (TWI_ACKACT_bm | TWI_MCMD_STOP_gc);	// NACK and STOP
+	release_BUS(BUSTWI);				// May run a deferred GMR sensor read
 
 }
 
@@ -172,6 +190,7 @@ uint8_t write_TWI(uint8_t data)
 uint8_t write_TWI(uint8_t data)
 {
 
+	TRACE_WDT(TRCTWIWRITE);
 	while (!(TWI0.MSTATUS & TWI_WIF_bm)) {	// Wait for previous writes
 		asm("nop");
 	}
@@ -181,7 +200,7 @@ uint8_t write_TWI(uint8_t data)
 	start_TCB0(1);			// Maybe only check on start_TWI?
 	while (!(TWI0.MSTATUS & TWI_WIF_bm)) {
 		asm("nop");
-		if (ticks > 50) {
+		if ((ticks > 50) || powerFail) {
 			stop_TCB0();
 			return(ERROR);
 			break;
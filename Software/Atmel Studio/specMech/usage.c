@@ -0,0 +1,270 @@
+/*------------------------------------------------------------------------------
+usage.c
+	Lifetime usage counters for maintenance: actuations and sensor-timed
+	transits for each pneumatic cylinder, and moves, travel, run time, and
+	peak current for each collimator axis.
+
+	Everything is counted in RAM from work that's being done anyway (the
+	valve and move commands, the GMR sensor interrupt, current reads) and
+	written to FRAM in one block along with the periodic encoder save and
+	at a power fail, so counting adds no bus traffic per operation. A
+	transit that keeps getting slower is a cylinder or valve wearing out.
+------------------------------------------------------------------------------*/
+
+#include "globals.h"
+#include <math.h>
+#include "errors.h"
+#include "commands.h"
+#include "ds3231.h"
+#include "fram.h"
+#include "rtc.h"
+#include "usart.h"
+#include "usage.h"
+
+Usage usage;
+uint8_t usageDirty;					// RAM counts not in FRAM yet
+char useTarget[PNEUMECHS];			// Position a cylinder was sent to, '\0' once timed
+uint32_t useStart[PNEUMECHS];		// RTC ticks when it was sent
+
+/*------------------------------------------------------------------------------
+void check_USEVALVES(void)
+	Time the transits that just finished. Called from the main loop after a
+	GMR sensor interrupt. It uses the state the interrupt captured
+	(pneuState) and when (pneuStamp), so no sensor read is needed here.
+------------------------------------------------------------------------------*/
+void check_USEVALVES(void)
+{
+
+	char position[PNEUMECHS], air;
+	uint8_t i, sreg;
+	uint16_t ms;
+	uint32_t stamp, elapsed;
+	ValveUse *v;
+
+	sreg = SREG;
+	cli();
+	stamp = pneuStamp;
+	SREG = sreg;
+	decode_PNEUSensors(pneuState, &position[0], &position[1], &position[2], &air);
+
+	for (i = 0; i < PNEUMECHS; i++) {
+		if ((useTarget[i] == '\0') || (position[i] != useTarget[i])) {
+			continue;
+		}
+		useTarget[i] = '\0';
+		elapsed = stamp - useStart[i];
+		if ((elapsed & 0x80000000) || (elapsed > USETRANSITMAX)) {	// Not this move
+			continue;
+		}
+		ms = (uint16_t) ((elapsed * 1000) / 512);
+		v = &usage.valve[i];
+		if ((v->transits == 0) || (ms < v->transitMin)) {
+			v->transitMin = ms;
+		}
+		if (ms > v->transitMax) {
+			v->transitMax = ms;
+		}
+		if (v->transits == 0) {
+			v->transitRecent = ms;
+		} else {
+			v->transitRecent = (uint16_t) ((((uint32_t) v->transitRecent * 7) + ms) / 8);
+		}
+		v->transitLast = ms;
+		v->transitSum += ms;
+		v->transits++;
+		usageDirty = YES;
+	}
+
+}
+
+/*------------------------------------------------------------------------------
+void count_USECURRENT(uint8_t axis, uint16_t current)
+	Keep the peak of every current read (get_MOTORCurrent)
+------------------------------------------------------------------------------*/
+void count_USECURRENT(uint8_t axis, uint16_t current)
+{
+
+	if ((current != 0x7FFF) && (current > usage.motor[axis].peakCurrent)) {
+		usage.motor[axis].peakCurrent = current;
+		usageDirty = YES;
+	}
+
+}
+
+/*------------------------------------------------------------------------------
+void count_USEMOVE(uint8_t axis, int32_t distance, MotionProfile *profile)
+	Count one move segment sent to a RoboClaw
+
+	Input:
+		axis - index into axes[]
+		distance - encoder counts (0 if the start position isn't known)
+		profile - the segment's motion profile
+
+	The run time is the trapezoid (or triangle, if the move is too short to
+	reach full speed) the profile describes.
+------------------------------------------------------------------------------*/
+void count_USEMOVE(uint8_t axis, int32_t distance, MotionProfile *profile)
+{
+
+	float d, v, a, dec, ramps, vpeak, t;
+	MotorUse *m;
+
+	m = &usage.motor[axis];
+	m->moves++;
+	if (distance < 0) {
+		distance = -distance;
+	}
+	m->travel += distance / axes[axis].countsPerMicron;
+
+	d = (float) distance;
+	v = (float) profile->speed;
+	a = (float) profile->acceleration;
+	dec = (float) profile->deceleration;
+	if ((d > 0.0) && (v > 0.0) && (a > 0.0) && (dec > 0.0)) {
+		ramps = ((v * v) / (2.0 * a)) + ((v * v) / (2.0 * dec));
+		if (ramps <= d) {
+			t = (v / a) + (v / dec) + ((d - ramps) / v);
+		} else {
+			vpeak = sqrt((2.0 * d * a * dec) / (a + dec));
+			t = (vpeak / a) + (vpeak / dec);
+		}
+		m->runTime += (uint32_t) ((t * 100.0) + 0.5);
+	}
+
+	usageDirty = YES;
+
+}
+
+/*------------------------------------------------------------------------------
+void count_USEVALVE(uint8_t mech, char target)
+	Count an open or close command and start timing the transit
+------------------------------------------------------------------------------*/
+void count_USEVALVE(uint8_t mech, char target)
+{
+
+	usage.valve[mech].actuations++;
+	useTarget[mech] = target;
+	useStart[mech] = get_RTCTicks();
+	usageDirty = YES;
+
+}
+
+/*------------------------------------------------------------------------------
+void init_USAGE(void)
+	Load the counters from FRAM, or start them at zero on a new board
+------------------------------------------------------------------------------*/
+void init_USAGE(void)
+{
+
+	uint8_t i;
+
+	if ((read_FRAM(FRAMTWIADDR, USEFRAMADDR, (uint8_t*) &usage, sizeof(Usage)) == ERROR) ||
+		(usage.valid != USEVALID)) {
+		memset(&usage, 0, sizeof(Usage));
+		usage.valid = USEVALID;
+	}
+	for (i = 0; i < PNEUMECHS; i++) {
+		useTarget[i] = '\0';
+	}
+	usageDirty = NO;
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t report_USAGE(uint8_t cstack)
+	Report the usage counters (the ru command), one sentence a mechanism
+		USE,<time>,valve,<s|l|r>,<actuations>,<transits>,<mean>,<min>,<max>,
+			<last>,<recent>,<ID>
+		USE,<time>,motor,<axis>,<moves>,<travel>,<run time>,<peak current>,<ID>
+	Transit times are in ms, travel in microns, run time in seconds, and
+	current in mA.
+------------------------------------------------------------------------------*/
+uint8_t report_USAGE(uint8_t cstack)
+{
+
+	char outbuf[BUFSIZE], currenttime[20];
+	const char format_USV[] = "USE,%s,valve,%c,%lu,%lu,%lu,%u,%u,%u,%u,%s";
+	const char format_USM[] = "USE,%s,motor,%c,%lu,%lu,%lu.%02u,%lu,%s";
+	const char valveNames[PNEUMECHS] = {'s', 'l', 'r'};
+	uint8_t i;
+	ValveUse *v;
+	MotorUse *m;
+
+	get_time(currenttime);
+	for (i = 0; i < PNEUMECHS; i++) {
+		v = &usage.valve[i];
+		sprintf(outbuf, format_USV, currenttime, valveNames[i], v->actuations,
+			v->transits, v->transits ? (v->transitSum / v->transits) : 0,
+			v->transitMin, v->transitMax, v->transitLast, v->transitRecent,
+			pcmd[cstack].cid);
+		printLine(outbuf);
+	}
+	for (i = 0; i < NAXES; i++) {
+		m = &usage.motor[i];
+		sprintf(outbuf, format_USM, currenttime, axes[i].name, m->moves,
+			m->travel, m->runTime / 100, (uint16_t) (m->runTime % 100),
+			(uint32_t) m->peakCurrent * 10, pcmd[cstack].cid);
+		printLine(outbuf);
+	}
+
+	return(NOERROR);
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t reset_USAGE(char name)
+	Zero one mechanism's counters after it's been replaced (the su command)
+
+	Input:
+		name - a cylinder (s, l, r) or an axis
+
+	Returns:
+		ERROR if there's no such mechanism, NOERROR otherwise
+------------------------------------------------------------------------------*/
+uint8_t reset_USAGE(char name)
+{
+
+	uint8_t axis;
+
+	switch (name) {
+		case 's':
+			memset(&usage.valve[0], 0, sizeof(ValveUse));
+			break;
+
+		case 'l':
+			memset(&usage.valve[1], 0, sizeof(ValveUse));
+			break;
+
+		case 'r':
+			memset(&usage.valve[2], 0, sizeof(ValveUse));
+			break;
+
+		default:
+			if ((axis = get_AXIS(name)) == ERROR) {
+				return(ERROR);
+			}
+			memset(&usage.motor[axis], 0, sizeof(MotorUse));
+			break;
+	}
+
+	usageDirty = YES;
+	return(NOERROR);
+
+}
+
+/*------------------------------------------------------------------------------
+void save_USAGE(void)
+	Write the counters to FRAM if anything changed. Called with the periodic
+	encoder save and from save_POWERFAIL.
+------------------------------------------------------------------------------*/
+void save_USAGE(void)
+{
+
+	if (!usageDirty) {
+		return;
+	}
+	if (write_FRAM(FRAMTWIADDR, USEFRAMADDR, (uint8_t*) &usage, sizeof(Usage)) == NOERROR) {
+		usageDirty = NO;
+	}
+
+}
@@ -0,0 +1,44 @@
+#ifndef USAGEH
+#define USAGEH
+
+#include "pneu.h"
+#include "roboclaw.h"
+
+#define USEVALID		0x5553	// "US" at the start of the FRAM copy
+#define USETRANSITMAX	5120	// Longer than this (1/512 sec, 10 s) isn't a transit
+
+typedef struct {
+	uint32_t actuations,		// Open and close commands
+	transits,					// Moves timed by the GMR sensors
+	transitSum;					// Sum of the timed transits (ms)
+	uint16_t transitMin,		// Fastest transit (ms)
+	transitMax,					// Slowest transit (ms)
+	transitLast,				// Latest transit (ms)
+	transitRecent;				// Running average, 1/8 weight to each new transit (ms)
+} ValveUse;
+
+typedef struct {
+	uint32_t moves,				// Move segments sent
+	travel,						// Commanded travel (microns)
+	runTime;					// Move time from the motion profiles (1/100 sec)
+	uint16_t peakCurrent;		// Highest current read (10 mA units)
+} MotorUse;
+
+typedef struct {
+	uint16_t valid;				// USEVALID once written
+	ValveUse valve[PNEUMECHS];	// Shutter, left, right (pneuHold order)
+	MotorUse motor[NAXES];		// axes[] order
+} Usage;
+
+extern uint8_t usageDirty;
+
+void check_USEVALVES(void);
+void count_USECURRENT(uint8_t, uint16_t);
+void count_USEMOVE(uint8_t, int32_t, MotionProfile*);
+void count_USEVALVE(uint8_t, char);
+void init_USAGE(void);
+uint8_t report_USAGE(uint8_t);
+uint8_t reset_USAGE(char);
+void save_USAGE(void);
+
+#endif
@@ -1,9 +1,63 @@
 #include "globals.h"
 #include "timers.h"
 #include "roboclaw.h"
+#include "commands.h"
 #include "usart.h"
+#include "wdt.h"
+#include "ds3231.h"
+#include "errors.h"
+#include "bod.h"
+
+USARTBuf send1_buf, send3_buf, recv1_buf, recv3_buf;
+TxQueue txq[NTXCLASSES];			// USART0 output queues
+uint8_t txClass;					// Class printLine output goes in
+volatile uint8_t tx0Frame,			// Class of the frame being sent
+tx0Left,							// Bytes left in that frame
+tx0Passed;							// Frames sent while bulk waited
+volatile uint16_t linkCount[NLINKS][NLNKCOUNTS];	// Link health (count_LINK)
 
-USARTBuf send0_buf, send1_buf, send3_buf, recv0_buf, recv1_buf, recv3_buf;
+/*------------------------------------------------------------------------------
+void count_LINK(uint8_t link, uint8_t counter)
+	Count one link error. Counters stop at 0xFFFF. Called from the receive
+	interrupts as well as the main loop.
+
+	Input:
+		link - LNKXPORT, LNKROBOCLAW, or LNKLN2
+		counter - LNKOVERRUN ... LNKTIMEOUT
+------------------------------------------------------------------------------*/
+void count_LINK(uint8_t link, uint8_t counter)
+{
+
+	uint8_t sreg;
+
+	sreg = SREG;
+	cli();
+	if (linkCount[link][counter] < 0xFFFF) {
+		linkCount[link][counter]++;
+	}
+	SREG = sreg;
+
+}
+
+/*------------------------------------------------------------------------------
+void count_RXERRORS(uint8_t link, uint8_t status)
+	Count the error flags in a USARTn.RXDATAH value. RXDATAH has to be read
+	before RXDATAL, which pops the byte and its flags.
+------------------------------------------------------------------------------*/
+void count_RXERRORS(uint8_t link, uint8_t status)
+{
+
+	if (status & USART_BUFOVF_bm) {
+		count_LINK(link, LNKOVERRUN);
+	}
+	if (status & USART_FERR_bm) {
+		count_LINK(link, LNKFRAMING);
+	}
+	if (status & USART_PERR_bm) {
+		count_LINK(link, LNKPARITY);
+	}
+
+}
 
 /*------------------------------------------------------------------------------
 void init_USART(void)
@@ -22,6 +76,8 @@ void init_USART(void)
 void init_USART(void)
 {
 
+	uint8_t i;
+
 	// USART0 PA0 is TxD, PA1 is RxD, Default pin position
 	PORTA.OUTSET = PIN0_bm;
 	PORTA.DIRSET = PIN0_bm;
@@ -30,14 +86,15 @@ void init_USART(void)
 	USART0.CTRLA |= USART_RXCIE_bm;		// Enable receive complete interrupt
 	USART0.CTRLB |= USART_TXEN_bm;		// Enable USART transmitter
 	USART0.CTRLB |= USART_RXEN_bm;		// Enable USART receiver
-	send0_buf.head = 0;					// Set up send/receive buffers
-	send0_buf.tail = 0;
-	send0_buf.done = YES;
-	recv0_buf.head = 0;
-	recv0_buf.tail = 0;
-	recv0_buf.data[0] = '\0';
-	recv0_buf.length = 0;
-	recv0_buf.done = NO;
+	for (i = 0; i < NTXCLASSES; i++) {	// Set up the output queues
+		txq[i].head = 0;
+		txq[i].tail = 0;
+	}
+	tx0Left = 0;
+	tx0Passed = 0;
+	txClass = TXCONTROL;
+	pcmdhead = 0;						// Received commands go into pcmd
+	pcmdtail = 0;
 
 	// USART1 PC0 is TxD, PC1 is RxD
 	PORTC.OUTSET = PIN0_bm;
@@ -65,6 +122,131 @@ void init_USART(void)
 
 }
 
+/*------------------------------------------------------------------------------
+void queue_USART0(uint8_t class, uint8_t *data, uint8_t nbytes)
+	Put one frame on a USART0 output queue and start the transmitter.
+
+	Input:
+		class - TXCONTROL, TXEVENT, or TXBULK
+		data - the bytes to send
+		nbytes - number of bytes, at most TXFRAMEMAX (longer is cut)
+
+	How it works:
+		The frame is stored as a length byte followed by the data and only
+		becomes visible to the DRE interrupt when head is moved past it. The
+		interrupt finishes the frame it's on before it looks at the queues
+		again, so a sentence is never split by one of another class. This
+		waits (1 second at most) only for room in its own queue, so a reply
+		doesn't wait behind a bulk transfer.
+------------------------------------------------------------------------------*/
+void queue_USART0(uint8_t class, uint8_t *data, uint8_t nbytes)
+{
+
+	uint8_t i, head;
+	TxQueue *q;
+
+	if (nbytes == 0) {
+		return;
+	}
+	if (nbytes > TXFRAMEMAX) {
+		nbytes = TXFRAMEMAX;
+	}
+
+	q = &txq[class];
+	start_TCB0(10);						// 10 ms ticks
+	TRACE_WDT(TRCUSART0);
+	while (room_USART0(class) < nbytes) {
+		if (powerFail) {				// Give way to save_POWERFAIL
+			stop_TCB0();
+			return;
+		}
+		if (ticks > 100) {				// 1 second enough?
+			stop_TCB0();
+			count_LINK(LNKXPORT, LNKTIMEOUT);
+			return;
+		}
+	}
+	stop_TCB0();
+
+	head = q->head;
+	q->data[head++] = nbytes;
+	for (i = 0; i < nbytes; i++) {
+		q->data[head++] = *data++;
+	}
+	q->head = head;						// The frame is complete
+	USART0.CTRLA |= USART_DREIE_bm;		// Enable interrupts
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t report_LINK(uint8_t cstack)
+	Report the link health counters (the rl command), one sentence a link
+		LNK,<time>,<link>,<overrun>,<framing>,<parity>,<dropped>,<crc>,<timeouts>,<ID>
+	<link> is xport, roboclaw, or ln2. The counts are since power-up or the
+	last sl (reset_LINK).
+------------------------------------------------------------------------------*/
+uint8_t report_LINK(uint8_t cstack)
+{
+
+	char outbuf[BUFSIZE], currenttime[20];
+	const char format_LNK[] = "LNK,%s,%s,%u,%u,%u,%u,%u,%u,%s";
+	const char *linkNames[NLINKS] = {"xport", "roboclaw", "ln2"};
+	uint8_t i, j, sreg;
+	uint16_t counts[NLNKCOUNTS];
+
+	get_time(currenttime);
+	for (i = 0; i < NLINKS; i++) {
+		sreg = SREG;
+		cli();
+		for (j = 0; j < NLNKCOUNTS; j++) {
+			counts[j] = linkCount[i][j];
+		}
+		SREG = sreg;
+		sprintf(outbuf, format_LNK, currenttime, linkNames[i],
+			counts[LNKOVERRUN], counts[LNKFRAMING], counts[LNKPARITY],
+			counts[LNKDROPPED], counts[LNKCRC], counts[LNKTIMEOUT],
+			pcmd[cstack].cid);
+		printLine(outbuf);
+	}
+
+	return(NOERROR);
+
+}
+
+/*------------------------------------------------------------------------------
+void reset_LINK(void)
+	Zero the link health counters
+------------------------------------------------------------------------------*/
+void reset_LINK(void)
+{
+
+	uint8_t i, j, sreg;
+
+	sreg = SREG;
+	cli();
+	for (i = 0; i < NLINKS; i++) {
+		for (j = 0; j < NLNKCOUNTS; j++) {
+			linkCount[i][j] = 0;
+		}
+	}
+	SREG = sreg;
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t room_USART0(uint8_t class)
+	Largest frame that fits in a USART0 output queue right now
+------------------------------------------------------------------------------*/
+uint8_t room_USART0(uint8_t class)
+{
+
+	uint8_t used;
+
+	used = txq[class].head - txq[class].tail;
+	return((used >= TXFRAMEMAX) ? 0 : (TXFRAMEMAX - used));
+
+}
+
 /*------------------------------------------------------------------------------
 void send_USART(uint8_t port, uint8_t *data, uint8_t nbytes)
 	Send data out a serial USART port.
@@ -81,10 +263,11 @@ void send_USART(uint8_t port, uint8_t *data, uint8_t nbytes)
 		Nothing
 
 	How it works:
-		This copies the data array into the send0_buf buffer and the enables
+		This copies the data array into the sendn_buf buffer and the enables
 		"transmit data register empty" interrupt (DREIE). The USARTn_DRE_vect
 		puts the bytes into the transmit register until the tail catches up
-		to the head of the circular buffer.
+		to the head of the circular buffer. USART0 output goes on the
+		TXCONTROL queue (see queue_USART0).
 ------------------------------------------------------------------------------*/
 void send_USART(uint8_t port, uint8_t *data, uint8_t nbytes)
 {
@@ -94,21 +277,7 @@ void send_USART(uint8_t port, uint8_t *data, uint8_t nbytes)
 
 	switch (port) {
 		case 0:
-			send0_buf.done = NO;
-			for (i = 0; i < nbytes; i++) {
-				send0_buf.data[send0_buf.head] = *data++;
-				send0_buf.head = (send0_buf.head + 1) % BUFSIZE;
-			}
-			USART0.CTRLA |= USART_DREIE_bm;		// Enable interrupts
-			start_TCB0(10);						// 10 ms ticks
-			while (send0_buf.done == NO) {
-				if (ticks > 100) {				// 1 second enough?
-					stop_TCB0();
-					send0_buf.done = YES;
-					return;
-				}
-			}
-			stop_TCB0();
+			queue_USART0(TXCONTROL, data, nbytes);
 			break;
 
 		case 1:			// Timeouts are handled in caller routines
@@ -145,36 +314,53 @@ ISR(USART0_RXC_vect)
 	A byte at USART0 has been received. This is the channel to the high level
 	control program coming in through the EtherNET port.
 
-	If the character received is not a <CR> ('\r') then the nxfrd (number of
-	bytes transferred) is incremented.
-
-	If the character received is a <CR> ('\r'), a string terminator ('\0') is
-	inserted into the buffer instead of the '\r'. The done flag is set and the
-	nxfrd value set back to 0.
+	The character goes straight to the command tokenizer, parse_cmd (see
+	commands.c), which splits the line into verb, object, value, and ID as it
+	arrives. When the <CR> ('\r') is seen the parsed command is put on the
+	pcmd stack for the command loop. The error flags in RXDATAH are counted
+	first (count_RXERRORS).
 ------------------------------------------------------------------------------*/
 ISR(USART0_RXC_vect)
 {
 
-	uint8_t c;
+	count_RXERRORS(LNKXPORT, USART0.RXDATAH);
+	parse_cmd(USART0.RXDATAL);
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t next_TX(void)
+	Pick the queue the next USART0 frame comes from. Control and events go
+	first, but while they keep the transmitter busy bulk still gets every
+	TXBULKSHARE-th frame. Returns NTXCLASSES if every queue is empty.
+------------------------------------------------------------------------------*/
+uint8_t next_TX(void)
+{
 
-	c = USART0.RXDATAL;
-	if (recv0_buf.length < (BUFSIZE-1)) {		// BUFSIZE-1 to make room for the terminating \0
-//		c = USART0.RXDATAL;
-		if ((char) c == '\r') {
-			recv0_buf.done = YES;
-			recv0_buf.data[recv0_buf.head] = '\0';
-		} else {
-			recv0_buf.data[recv0_buf.head] = c;
+	uint8_t class, bulkWaiting;
+
+	bulkWaiting = (txq[TXBULK].head != txq[TXBULK].tail);
+	if (bulkWaiting && (tx0Passed >= (TXBULKSHARE-1))) {
+		tx0Passed = 0;
+		return(TXBULK);
+	}
+
+	for (class = TXCONTROL; class < TXBULK; class++) {
+		if (txq[class].head != txq[class].tail) {
+			if (bulkWaiting) {
+				tx0Passed++;
+			}
+			return(class);
 		}
-		recv0_buf.length++;
-		recv0_buf.head = (recv0_buf.head + 1) % BUFSIZE;
-	} else {
-		recv0_buf.head = 0;
-		recv0_buf.tail = 0;
-		recv0_buf.data[0] = '\0';
-		recv0_buf.length = 0;
-		recv0_buf.done = NO;
 	}
+
+	if (bulkWaiting) {
+		tx0Passed = 0;
+		return(TXBULK);
+	}
+
+	return(NTXCLASSES);
+
 }
 
 /*------------------------------------------------------------------------------
@@ -182,41 +368,50 @@ ISR(USART0_DRE_vect)
 	Transmit data register empty interrupt. When the transmit data register
 	(USART0.TXDATAL) is empty and the interrupt is enabled, you end up here.
 	
-	Here, we send out another byte of data and then compare the number of
-	bytes already transferred (nxfrd) with the number requested (nbytes).
-	If nxfrd == nbytes, then we set the send0_buf.done flag to YES and turn
-	off this interrupt.
+	Here, we send out the next byte of the frame being sent. At the end of a
+	frame next_TX picks the queue for the next one; when they're all empty
+	this interrupt is turned off.
 
-	Sending is started by calling send_USART(port).
+	Sending is started by calling queue_USART0.
 ------------------------------------------------------------------------------*/
 ISR(USART0_DRE_vect)
 {
 
-	USART0.CTRLA &= ~USART_DREIE_bm;	// Turn off interrupts
-	if (send0_buf.head - send0_buf.tail) {
-		USART0.TXDATAL = send0_buf.data[send0_buf.tail++];
-		send0_buf.tail %= BUFSIZE;
-		USART0.CTRLA |= USART_DREIE_bm;		// Turn on interrupts
-	} else {
-		send0_buf.done = YES;
+	TxQueue *q;
+
+	if (tx0Left == 0) {					// Frame boundary
+		tx0Frame = next_TX();
+		if (tx0Frame == NTXCLASSES) {
+			USART0.CTRLA &= ~USART_DREIE_bm;	// Nothing left, turn off interrupts
+			return;
+		}
+		q = &txq[tx0Frame];
+		tx0Left = q->data[q->tail++];
 	}
 
+	q = &txq[tx0Frame];
+	USART0.TXDATAL = q->data[q->tail++];
+	tx0Left--;
+
 }
 
 /*------------------------------------------------------------------------------
 ISR(USART1_RXC_vect)
-	A byte at USART1 has been received.
-
+	A byte at USART1 has been received. Bytes past the expected reply length
+	are dropped and counted.
 ------------------------------------------------------------------------------*/
 ISR(USART1_RXC_vect)
 {
 
 	uint8_t c;
 
+	count_RXERRORS(LNKROBOCLAW, USART1.RXDATAH);
 	c = USART1.RXDATAL;
 
 	if (recv1_buf.nxfrd < recv1_buf.nbytes) {
 		recv1_buf.data[recv1_buf.nxfrd++] = c;
+	} else {
+		count_LINK(LNKROBOCLAW, LNKDROPPED);
 	}
 
 	if (recv1_buf.nxfrd >= recv1_buf.nbytes) {
@@ -268,7 +463,11 @@ ISR(USART3_RXC_vect)
 
 	uint8_t c;
 
+	count_RXERRORS(LNKLN2, USART3.RXDATAH);
 	c = USART3.RXDATAL;
+	if ((recv3_buf.nxfrd >= (BUFSIZE-1)) && ((char) c != '\r')) {
+		count_LINK(LNKLN2, LNKDROPPED);		// Line too long, cut here
+	}
 	if (((char) c == '\r') || (recv3_buf.nxfrd >= (BUFSIZE-1))) {
 		recv3_buf.done = YES;
 		recv3_buf.data[recv3_buf.nxfrd] = 0;	// String terminator
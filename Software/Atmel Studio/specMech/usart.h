@@ -4,6 +4,15 @@
 #define BUFSIZE 254
 #define	USART_BAUD_RATE(BAUD_RATE)	((float)(F_CPU * 64 / (16 * (float)BAUD_RATE)) + 0.5)
 
+// USART0 output classes. Each has its own queue and the transmitter picks
+// the next frame (one send) from the highest class with one waiting.
+#define TXCONTROL		0		// Command replies and prompts
+#define TXEVENT			1		// Unsolicited sentences (printEvent)
+#define TXBULK			2		// Long transfers (rj dump)
+#define NTXCLASSES		3
+#define TXBULKSHARE		4		// Bulk gets 1 frame in 4 while the others have some
+#define TXFRAMEMAX		254		// Longest frame (queue size less the length byte)
+
 typedef struct {
 	uint8_t				// Serial I/O buffer
 	data[BUFSIZE],		// Data to send or data received
@@ -15,11 +24,40 @@ typedef struct {
 	uint8_t	volatile done;	// Is the transfer complete ('\r' seen)?
 } USARTBuf;
 
+// Link health counters (linkCount[link][counter], see report_LINK)
+#define LNKXPORT		0		// USART0, the host
+#define LNKROBOCLAW		1		// USART1, the motor controllers
+#define LNKLN2			2		// USART3, the LN2 controller
+#define NLINKS			3
+#define LNKOVERRUN		0		// Receive buffer overflow (RXDATAH BUFOVF)
+#define LNKFRAMING		1		// Framing error (RXDATAH FERR)
+#define LNKPARITY		2		// Parity error (RXDATAH PERR)
+#define LNKDROPPED		3		// Bytes or lines dropped, software buffer full
+#define LNKCRC			4		// Checksum failures
+#define LNKTIMEOUT		5		// Replies or sends that timed out
+#define NLNKCOUNTS		6
+
+typedef struct {
+	uint8_t data[256];	// Frames: a length byte followed by the bytes
+	uint8_t volatile	// The DRE interrupt moves tail while queue_USART0 waits
+	head,				// uint8_t indexes wrap with the buffer
+	tail;
+} TxQueue;
+
 extern USARTBuf
-	send0_buf, send1_buf, send3_buf,
-	recv0_buf, recv1_buf, recv3_buf;
+	send1_buf, send3_buf,
+	recv1_buf, recv3_buf;
+
+extern uint8_t txClass;
 
+void count_LINK(uint8_t, uint8_t);
+void count_RXERRORS(uint8_t, uint8_t);
 void init_USART(void);
+void queue_USART0(uint8_t, uint8_t*, uint8_t);
+uint8_t next_TX(void);
+uint8_t report_LINK(uint8_t);
+void reset_LINK(void);
+uint8_t room_USART0(uint8_t);
 void send_USART(uint8_t, uint8_t*, uint8_t);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,350 @@
+#include "globals.h"
+#include "errors.h"
+#include "commands.h"
+#include "report.h"
+#include "roboclaw.h"
+#include "watch.h"
+
+WatchSlot watchlist[WATCHSLOTS];
+uint8_t timerWATCH;					// Seconds since check_WATCH (RTC ticks)
+uint8_t minWATCH, maxWATCH;			// Sampling interval range (sec)
+uint16_t heartbeatWATCH;			// Send a sentence at least this often (sec)
+
+/*------------------------------------------------------------------------------
+void adapt_WATCH(WatchSlot *slot, float *fields, uint8_t dt)
+	Set a slot's next sampling interval from how its fields are moving.
+
+	Each field keeps an averaged rate of change and an averaged scatter
+	about that rate (noise). The interval a field wants is the time it takes
+	to move half its deadband at that rate, so a change is seen in two or
+	more samples. Noise bigger than the deadband stands in for it, so a
+	noisy but flat signal isn't chased. The slot takes the shortest interval
+	any field wants, limited to minWATCH..maxWATCH. It speeds up at once and
+	slows down by doubling, so sampling goes where things are changing and
+	a flat sensor costs one TWI read every maxWATCH seconds.
+
+	Input:
+		slot - the watch slot, with prev[] holding the last sample
+		fields - the new sample
+		dt - seconds between the two samples
+------------------------------------------------------------------------------*/
+void adapt_WATCH(WatchSlot *slot, float *fields, uint8_t dt)
+{
+
+	uint8_t j;
+	float d, r, scale, want, desired;
+
+	if (slot->object == 'p') {			// States, not levels
+		slot->interval = minWATCH;
+		return;
+	}
+
+	want = (float) maxWATCH;
+	for (j = 0; j < slot->nfields; j++) {
+		if ((fields[j] == BADFLOAT) || (slot->prev[j] == BADFLOAT)) {
+			continue;
+		}
+		d = fields[j] - slot->prev[j];
+		r = d - (slot->rate[j] * (float) dt);
+		if (r < 0.0) {
+			r = -r;
+		}
+		slot->noise[j] += (r - slot->noise[j]) / WATCHSMOOTH;
+		slot->rate[j] += ((d / (float) dt) - slot->rate[j]) / WATCHSMOOTH;
+
+		r = (slot->rate[j] < 0.0) ? -slot->rate[j] : slot->rate[j];
+		if (r == 0.0) {
+			continue;
+		}
+		scale = (slot->deadband[j] > slot->noise[j]) ? slot->deadband[j] : slot->noise[j];
+		desired = scale / (2.0 * r);
+		if (desired < want) {
+			want = desired;
+		}
+	}
+
+	if (want < (float) slot->interval) {
+		slot->interval = (want < (float) minWATCH) ? minWATCH : (uint8_t) want;
+	} else {
+		if ((uint16_t) slot->interval * 2 < want) {
+			want = (float) slot->interval * 2;
+		}
+		slot->interval = (want > (float) maxWATCH) ? maxWATCH : (uint8_t) want;
+	}
+
+}
+
+/*------------------------------------------------------------------------------
+void check_WATCH(void)
+	Report-by-exception. Samples each watched object when its own interval
+	(see adapt_WATCH) is up and sends its report sentence if any field moved
+	more than its deadband from the value last sent, or if the heartbeat
+	period has gone by without a sentence. Called from the main loop every
+	second.
+
+	The sensor objects (TWI) are sampled first. The position of the first
+	watched axis due is read on USART1 while they are, the way take_SNAPSHOT
+	does it; any other axis is read after them, one trip at a time.
+
+	Unsolicited sentences have an empty command ID and go through the
+	outbox (EVT,<seq>,<sentence>).
+------------------------------------------------------------------------------*/
+void check_WATCH(void)
+{
+
+	uint8_t i, elapsed, due, started, axis;
+	uint8_t dt[WATCHSLOTS];
+	int32_t encoderValue;
+	float fields[REPORTFIELDS];
+	WatchSlot *slot, *overlap;
+
+	elapsed = timerWATCH;
+	timerWATCH = 0;
+
+	due = 0;
+	overlap = NULL;
+	for (i = 0; i < WATCHSLOTS; i++) {
+		slot = &watchlist[i];
+		if (slot->object == '\0') {
+			continue;
+		}
+		if (slot->age < (0xFFFF - elapsed)) {
+			slot->age += elapsed;
+		}
+		slot->since = (slot->since < (0xFF - elapsed)) ? slot->since + elapsed : 0xFF;
+		if ((slot->since < slot->interval) &&
+			!(heartbeatWATCH && (slot->age >= heartbeatWATCH))) {
+			continue;
+		}
+		dt[i] = slot->since;
+		slot->since = 0;
+		due |= (1 << i);
+		if ((overlap == NULL) && (slot->object >= 'a') && (slot->object <= 'z') &&
+			(strchr(WATCHOBJECTS, slot->object) == NULL)) {
+			overlap = slot;
+		}
+	}
+
+	started = NO;
+	if (overlap != NULL) {
+		started = (start_MOTOREncoder(get_AXIS(overlap->object), ROBOREADENCODERCOUNT) == NOERROR);
+	}
+
+	for (i = 0; i < WATCHSLOTS; i++) {		// Sensors while USART1 works
+		slot = &watchlist[i];
+		if ((due & (1 << i)) && (strchr(WATCHOBJECTS, slot->object) != NULL)) {
+			slot->nfields = get_REPORT(slot->object, NULL, fields);
+			send_WATCH(slot, fields, dt[i]);
+		}
+	}
+
+	if (started && (end_MOTOREncoder(&encoderValue) == ERROR)) {
+		started = NO;
+	}
+
+	for (i = 0; i < WATCHSLOTS; i++) {		// Then the axes
+		slot = &watchlist[i];
+		if (!(due & (1 << i)) || (strchr(WATCHOBJECTS, slot->object) != NULL)) {
+			continue;
+		}
+		if (slot == overlap) {
+			axis = get_AXIS(slot->object);
+			slot->nfields = get_REPORT(slot->object, "sc", fields);
+			if (!started) {
+				encoderValue = 0x7FFFFFFF;
+			}
+			fields[0] = (float) (encoderValue/(int32_t) axes[axis].countsPerMicron);
+		} else {
+			slot->nfields = get_REPORT(slot->object, NULL, fields);
+		}
+		send_WATCH(slot, fields, dt[i]);
+	}
+
+}
+
+/*------------------------------------------------------------------------------
+void init_WATCH(void)
+	Nothing watched, default interval range and heartbeat
+------------------------------------------------------------------------------*/
+void init_WATCH(void)
+{
+
+	uint8_t i;
+
+	for (i = 0; i < WATCHSLOTS; i++) {
+		watchlist[i].object = '\0';
+	}
+	timerWATCH = 0;
+	minWATCH = WATCHMIN;
+	maxWATCH = WATCHMAX;
+	heartbeatWATCH = WATCHHEARTBEAT;
+
+}
+
+/*------------------------------------------------------------------------------
+void send_WATCH(WatchSlot *slot, float *fields, uint8_t dt)
+	Take a new sample of a watched object (read by check_WATCH), adapt its
+	interval and send its sentence if a field moved past its deadband or the
+	heartbeat is due.
+------------------------------------------------------------------------------*/
+void send_WATCH(WatchSlot *slot, float *fields, uint8_t dt)
+{
+
+	uint8_t j, changed;
+	float diff;
+
+	adapt_WATCH(slot, fields, dt);
+	memcpy(slot->prev, fields, sizeof(slot->prev));
+	changed = NO;
+	for (j = 0; j < slot->nfields; j++) {
+		diff = fields[j] - slot->last[j];
+		if (diff < 0.0) {
+			diff = -diff;
+		}
+		if (diff > slot->deadband[j]) {
+			changed = YES;
+		}
+	}
+	if (changed || (heartbeatWATCH && (slot->age >= heartbeatWATCH))) {
+		put_REPORT(slot->object, NULL, fields, "", YES);
+		memcpy(slot->last, fields, sizeof(slot->last));
+		slot->age = 0;
+	}
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t watch(uint8_t cstack)
+	Turn report-by-exception on or off for a report object
+
+	Input:
+		cstack - the pcmd entry holding the watch command. The forms are:
+			wi<min>,<max> - sampling interval range in seconds (1-255).
+				Each object's interval moves within it (see adapt_WATCH).
+			wi<sec> - fixed sampling interval in seconds (1-255)
+			wh<sec> - heartbeat in seconds (0 turns it off)
+			w<obj>off - stop watching the report object
+			w<obj><deadbands> - watch the report object. Deadbands are
+				separated by '/' and go with the sentence fields in order,
+				starting over from the first when they run out. No value
+				means any change is reported. For example, "we0.2/2" sends
+				ENV when any temperature (t0-t3) moves 0.2 C or any humidity
+				(h0-h2) moves 2%.
+			Pneumatic states (wp) are reported on any change.
+
+	Output:
+		Sends the current report for a newly watched object with the command
+		ID so the host starts with a baseline.
+
+	Returns:
+		ERROR or NOERROR
+------------------------------------------------------------------------------*/
+uint8_t watch(uint8_t cstack)
+{
+
+	char object, *ptr, *end;
+	uint8_t i, ndeadbands;
+	int32_t seconds, slowest;
+	float deadbands[REPORTFIELDS];
+	WatchSlot *slot;
+
+	object = pcmd[cstack].cobject;
+	ptr = pcmd[cstack].cvalue;
+
+	switch (object) {
+		case 'i':
+			seconds = strtol(ptr, &end, 10);
+			slowest = seconds;
+			if (*end == ',') {
+				ptr = end + 1;
+				slowest = strtol(ptr, &end, 10);
+			}
+			if ((end == ptr) || (*end != '\0') || (seconds < 1) ||
+				(slowest < seconds) || (slowest > 255)) {
+				printError(ERR_WATCHVALUE, "watch: interval 1-255 sec or <min>,<max>");
+				return(ERROR);
+			}
+			minWATCH = (uint8_t) seconds;
+			maxWATCH = (uint8_t) slowest;
+			for (i = 0; i < WATCHSLOTS; i++) {
+				watchlist[i].interval = minWATCH;
+			}
+			return(NOERROR);
+
+		case 'h':
+			seconds = atol(ptr);
+			if ((seconds < 0) || (seconds > 65535)) {
+				printError(ERR_WATCHVALUE, "watch: heartbeat 0-65535 sec");
+				return(ERROR);
+			}
+			heartbeatWATCH = (uint16_t) seconds;
+			return(NOERROR);
+
+		default:
+			break;
+	}
+
+	if ((strchr(WATCHOBJECTS, object) == NULL) && (get_AXIS(object) == ERROR)) {
+		printError(ERR_WATCH, "watch: can't watch object");
+		return(ERROR);
+	}
+
+	slot = NULL;
+	for (i = 0; i < WATCHSLOTS; i++) {		// Already watched?
+		if (watchlist[i].object == object) {
+			slot = &watchlist[i];
+		}
+	}
+
+	if (strcmp(ptr, "off") == 0) {
+		if (slot != NULL) {
+			slot->object = '\0';
+		}
+		return(NOERROR);
+	}
+
+	if (slot == NULL) {
+		for (i = 0; i < WATCHSLOTS; i++) {
+			if (watchlist[i].object == '\0') {
+				slot = &watchlist[i];
+				break;
+			}
+		}
+	}
+	if (slot == NULL) {
+		printError(ERR_WATCHFULL, "watch: too many objects");
+		return(ERROR);
+	}
+
+	deadbands[0] = 0.0;
+	ndeadbands = 1;
+	for (i = 0; (i < REPORTFIELDS) && (*ptr != '\0'); i++) {
+		deadbands[i] = strtod(ptr, &end);
+		if ((end == ptr) || ((*end != '/') && (*end != '\0')) || (deadbands[i] < 0.0)) {
+			printError(ERR_WATCHVALUE, "watch: bad deadband");
+			return(ERROR);
+		}
+		ptr = (*end == '/') ? end + 1 : end;
+		ndeadbands = i + 1;
+	}
+	if (*ptr != '\0') {
+		printError(ERR_WATCHVALUE, "watch: too many deadbands");
+		return(ERROR);
+	}
+	for (i = 0; i < REPORTFIELDS; i++) {	// Cycle them through the fields
+		slot->deadband[i] = (object == 'p') ? 0.0 : deadbands[i % ndeadbands];
+	}
+
+	slot->object = object;
+	slot->age = 0;
+	slot->since = 0;
+	slot->interval = minWATCH;			// Start fast, adapt_WATCH eases off
+	slot->nfields = get_REPORT(object, NULL, slot->last);
+	memcpy(slot->prev, slot->last, sizeof(slot->prev));
+	memset(slot->rate, 0, sizeof(slot->rate));
+	memset(slot->noise, 0, sizeof(slot->noise));
+	put_REPORT(object, NULL, slot->last, pcmd[cstack].cid, NO);
+
+	return(NOERROR);
+
+}
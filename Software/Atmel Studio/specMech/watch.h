@@ -0,0 +1,35 @@
+#ifndef WATCHH
+#define WATCHH
+
+#include "report.h"
+
+#define WATCHSLOTS		4	// Number of report objects that can be watched at once
+#define WATCHMIN		1	// Default fastest sampling interval (sec)
+#define WATCHMAX		30	// Default slowest sampling interval (sec)
+#define WATCHSMOOTH		4	// Rate and noise averages weight a new sample 1/WATCHSMOOTH
+#define WATCHHEARTBEAT	300	// Default heartbeat (sec), 0 turns it off
+#define WATCHOBJECTS	"eopv"	// Sensor objects that can be watched (plus any axis)
+
+typedef struct {
+	char object;					// Report object, '\0' if the slot is free
+	uint8_t nfields;				// Number of fields in the report
+	uint8_t interval;				// Current sampling interval (sec)
+	uint8_t since;					// Seconds since the last sample
+	uint16_t age;					// Seconds since the last sentence was sent
+	float deadband[REPORTFIELDS],	// Change needed before a sentence is sent
+	last[REPORTFIELDS],				// Values in the last sentence sent
+	prev[REPORTFIELDS],				// Values in the last sample
+	rate[REPORTFIELDS],				// Averaged rate of change (units/sec)
+	noise[REPORTFIELDS];			// Averaged scatter about that rate (units)
+} WatchSlot;
+
+extern uint8_t timerWATCH, minWATCH, maxWATCH;
+extern uint16_t heartbeatWATCH;
+
+void adapt_WATCH(WatchSlot*, float*, uint8_t);
+void check_WATCH(void);
+void init_WATCH(void);
+void send_WATCH(WatchSlot*, float*, uint8_t);
+uint8_t watch(uint8_t);
+
+#endif
@@ -0,0 +1,140 @@
+/*------------------------------------------------------------------------------
+waypoint.c
+	Multi-segment moves. move_MOTOR loads all the segments into the RoboClaw
+	command buffer at once so they run back-to-back. These routines watch the
+	buffer depth and send a WPT sentence as each segment finishes.
+------------------------------------------------------------------------------*/
+
+#include "globals.h"
+#include "errors.h"
+#include "commands.h"
+#include "ds3231.h"
+#include "roboclaw.h"
+#include "rtc.h"
+#include "usart.h"
+#include "waypoint.h"
+#include "outbox.h"
+
+Waypoints waypoints[NAXES];			// One per axis in axes[]
+uint32_t wptLastPoll;				// RTC ticks at the last buffer poll
+
+/*------------------------------------------------------------------------------
+void check_WAYPOINTS(void)
+	Called from the main loop. Every WPTPOLLTICKS it reads the buffer depth
+	of each axis running a waypoint list and reports the segments that
+	finished since the last poll. Command 47 returns both channels, so each
+	controller is read once per poll and shared by the axes on it:
+		WPT,<time>,<motor>,<segment>,<nsegments>,<ID of the m command>
+	The encoder count is read when a segment finishes, which keeps
+	lastEncoder (the power-fail save) current through the list.
+------------------------------------------------------------------------------*/
+void check_WAYPOINTS(void)
+{
+
+	char outbuf[BUFSIZE], currenttime[20];
+	const char format_WPT[] = "WPT,%s,%c,%d,%d,%s";
+	uint8_t i, j, active, depth, done, depths[NAXES][2], valid[NAXES];
+	int32_t position;
+	Waypoints *w;
+
+	for (i = 0, active = NO; i < NAXES; i++) {
+		if (waypoints[i].nsegments) {
+			active = YES;
+		}
+	}
+	if (!active) {
+		return;
+	}
+	if ((get_RTCTicks() - wptLastPoll) < WPTPOLLTICKS) {
+		return;
+	}
+	wptLastPoll = get_RTCTicks();
+
+	for (i = 0; i < NAXES; i++) {
+		valid[i] = NO;
+		w = &waypoints[i];
+		if (w->nsegments == 0) {
+			continue;
+		}
+		for (j = 0; j < i; j++) {		// Already read this controller?
+			if (valid[j] && (axes[j].address == axes[i].address)) {
+				depths[i][0] = depths[j][0];
+				depths[i][1] = depths[j][1];
+				valid[i] = YES;
+				break;
+			}
+		}
+		if (!valid[i]) {
+			if (get_MOTORBuffer(axes[i].address, depths[i]) == ERROR) {
+				continue;
+			}
+			valid[i] = YES;
+		}
+		depth = depths[i][axes[i].channel - 1];
+		if (depth == ROBOBUFFEREMPTY) {
+			done = w->nsegments;
+		} else if ((depth + 1) >= w->nsegments) {	// Waiting plus the one running
+			done = 0;
+		} else {
+			done = w->nsegments - (depth + 1);
+		}
+		if (w->done < done) {
+			get_MOTOREncoder(i, ROBOREADENCODERCOUNT, &position);
+		}
+		while (w->done < done) {
+			w->done++;
+			get_time(currenttime);
+			sprintf(outbuf, format_WPT, currenttime, axes[i].name, w->done,
+				w->nsegments, w->cid);
+			printEvent(outbuf);
+		}
+		if (w->done >= w->nsegments) {
+			w->nsegments = 0;
+		}
+	}
+
+}
+
+/*------------------------------------------------------------------------------
+void start_WAYPOINTS(uint8_t axis, uint8_t nsegments, char *cid)
+	Start reporting segment completion for a waypoint list that was just
+	loaded into an axis's buffer.
+------------------------------------------------------------------------------*/
+void start_WAYPOINTS(uint8_t axis, uint8_t nsegments, char *cid)
+{
+
+	Waypoints *w;
+
+	w = &waypoints[axis];
+	w->nsegments = nsegments;
+	w->done = 0;
+	strcpy(w->cid, cid);
+	wptLastPoll = get_RTCTicks();
+
+}
+
+/*------------------------------------------------------------------------------
+void stop_WAYPOINTS(uint8_t axis)
+	Stop reporting on an axis (a single move was queued behind the
+	list or loading the list failed).
+------------------------------------------------------------------------------*/
+void stop_WAYPOINTS(uint8_t axis)
+{
+
+	waypoints[axis].nsegments = 0;
+
+}
+
+/*------------------------------------------------------------------------------
+uint8_t waypointsActive(uint8_t axis)
+	YES if a waypoint list is still running on the axis
+------------------------------------------------------------------------------*/
+uint8_t waypointsActive(uint8_t axis)
+{
+
+	if (waypoints[axis].nsegments) {
+		return(YES);
+	}
+	return(NO);
+
+}
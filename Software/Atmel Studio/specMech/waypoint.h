@@ -0,0 +1,20 @@
+#ifndef WAYPOINTH
+#define WAYPOINTH
+
+#include "commands.h"
+
+#define WPTMAX			8		// Most waypoints in one m command
+#define WPTPOLLTICKS	26		// Poll the RoboClaw buffers every ~50 ms (1/512 sec)
+
+typedef struct {
+	uint8_t nsegments,			// Segments loaded, 0 if nothing to watch
+	done;						// Segments reported finished
+	char cid[CIDSIZE];			// ID of the m command that loaded them
+} Waypoints;
+
+void check_WAYPOINTS(void);
+void start_WAYPOINTS(uint8_t, uint8_t, char*);
+void stop_WAYPOINTS(uint8_t);
+uint8_t waypointsActive(uint8_t);
+
+#endif
@@ -1,19 +1,172 @@
+/*------------------------------------------------------------------------------
+wdt.c
+	Watchdog. The WDT runs all the time with its longest period (~8 sec) and
+	is fed from the RTC interrupt, but only while the main loop task that is
+	running (begin_TASK/end_TASK) is inside its deadline. When a task
+	overruns, the task and the last trace point it passed are written to
+	.noinit RAM, which survives the watchdog reset, and are reported once
+	with a WDT sentence after the reboot is acknowledged:
+		WDT,<time>,<task>,<trace>,<seconds>
+------------------------------------------------------------------------------*/
+
 #include "globals.h"
+#include <avr/wdt.h>
 #include "initialize.h"
 #include "roboclaw.h"
 #include "errors.h"
+#include "ds3231.h"
+#include "rtc.h"
+#include "usart.h"
+#include "outbox.h"
 #include "wdt.h"
 
+volatile uint8_t wdtTrace;			// Last trace point passed (TRACE_WDT)
+volatile uint8_t wdtTask;			// Task running now, TSKIDLE between tasks
+volatile uint32_t wdtStart;			// RTC ticks when wdtTask started
+uint8_t wdtOverrun;					// Stop feeding the watchdog
+uint8_t wdtPending;					// Report the record after the reboot ACK
+WdtRecord wdtRecord __attribute__ ((section (".noinit")));
+
+// Task deadlines (sec). commands() and replay_OUTBOX() can wait on several
+// 1-sec USART timeouts in a row.
+const uint8_t wdtDeadline[NTASKS] = {
+	0,		// TSKIDLE
+	30,		// TSKINIT
+	10,		// TSKCOMMANDS
+	60,		// TSKREPLAY
+	5,		// TSKOLED
+	5,		// TSKENCODERS
+	5,		// TSKTRAJECTORY
+	5,		// TSKWAYPOINTS
+	10,		// TSKSNAPSHOT
+	10,		// TSKWATCH
+	5,		// TSKPOWERFAIL
+	5,		// TSKALARM
+	10,		// TSKBUS
+	5		// TSKWDTREPORT
+};
+
+const char *wdtTaskNames[NTASKS] = {"idle", "init", "commands", "replay",
+	"oled", "encoders", "trajectory", "waypoints", "snapshot", "watch",
+	"powerfail", "alarm", "bus", "wdtreport"};
+const char *wdtTraceNames[NTRACES] = {"none", "twiread", "twiwrite",
+	"ads1115", "roboclaw", "usart0"};
+
+/*------------------------------------------------------------------------------
+void begin_TASK(uint8_t task)
+	Start the deadline clock for a main loop task
+------------------------------------------------------------------------------*/
+void begin_TASK(uint8_t task)
+{
+
+	wdtStart = get_RTCTicks();
+	wdtTrace = TRCNONE;
+	wdtTask = task;
+
+}
+
+/*------------------------------------------------------------------------------
+void check_WDT(void)
+	Called from the RTC interrupt. Feeds the watchdog unless the running task
+	is past its deadline. The first time that happens the overrun is written
+	to the .noinit record and the watchdog is left to reset the processor.
+------------------------------------------------------------------------------*/
+void check_WDT(void)
+{
+
+	uint32_t elapsed;
+
+	if (wdtOverrun) {
+		return;
+	}
+
+	if (wdtTask != TSKIDLE) {
+		elapsed = rtcTicks - wdtStart;
+		if (elapsed > ((uint32_t) wdtDeadline[wdtTask] * 512)) {
+			wdtRecord.task = wdtTask;
+			wdtRecord.trace = wdtTrace;
+			wdtRecord.seconds = (uint16_t) (elapsed / 512);
+			wdtRecord.magic = WDTMAGIC;
+			wdtOverrun = YES;
+			return;
+		}
+	}
+
+	wdt_reset();
+
+}
+
+/*------------------------------------------------------------------------------
+void end_TASK(void)
+	The task finished in time
+------------------------------------------------------------------------------*/
+void end_TASK(void)
+{
+
+	wdtTask = TSKIDLE;
+
+}
+
+/*------------------------------------------------------------------------------
+void init_WDT(void)
+	Check whether the last reset was a task overrun, then start the watchdog.
+	Call this last in initialize0, once the RTC interrupt that feeds it is
+	set up.
+------------------------------------------------------------------------------*/
+void init_WDT(void)
+{
+
+	if ((RSTCTRL.RSTFR & RSTCTRL_WDRF_bm) && (wdtRecord.magic == WDTMAGIC)) {
+		wdtPending = YES;
+	}
+	wdtRecord.magic = 0;
+	RSTCTRL.RSTFR = RSTCTRL.RSTFR;	// Clear the reset flags (write 1 to clear)
+
+	wdtOverrun = NO;
+	wdtTask = TSKIDLE;
+	while (WDT.STATUS & WDT_SYNCBUSY_bm) {
+		asm("nop");
+	}
+	CPU_CCP = CCP_IOREG_gc;
+	WDT.CTRLA = WDT_PERIOD_8KCLK_gc;
+
+}
+
 void reboot(void)
 {
 
 //	init_USART();
 //	init_XPORT();
+	while (WDT.STATUS & WDT_SYNCBUSY_bm) {	// The WDT is already running
+		asm("nop");
+	}
 	CPU_CCP = CCP_IOREG_gc;
 	WDT.CTRLA = WDT_PERIOD_8CLK_gc;
 
 }
 
+/*------------------------------------------------------------------------------
+void report_WDT(void)
+	Send the overrun that caused the last reset. Called once from the main
+	loop after the reboot acknowledge.
+------------------------------------------------------------------------------*/
+void report_WDT(void)
+{
+
+	char outbuf[BUFSIZE], currenttime[20];
+	const char format_WDT[] = "WDT,%s,%s,%s,%u";
+	uint8_t task, trace;
+
+	wdtPending = NO;
+	task = (wdtRecord.task < NTASKS) ? wdtRecord.task : TSKIDLE;
+	trace = (wdtRecord.trace < NTRACES) ? wdtRecord.trace : TRCNONE;
+	get_time(currenttime);
+	sprintf(outbuf, format_WDT, currenttime, wdtTaskNames[task],
+		wdtTraceNames[trace], wdtRecord.seconds);
+	printEvent(outbuf);
+
+}
+
 ISR(PORTF_PORT_vect)
 {
 
@@ -1,6 +1,51 @@
 #ifndef WDTH
 #define WDTH
 
+#define WDTMAGIC		0x5744	// "WD" in the .noinit record, an overrun was logged
+
+// Main loop tasks. Each has a deadline in wdtDeadline[] (wdt.c).
+#define TSKIDLE			0		// Between tasks
+#define TSKINIT			1		// initialize1
+#define TSKCOMMANDS		2		// commands()
+#define TSKREPLAY		3		// replay_OUTBOX()
+#define TSKOLED			4		// Display timeout
+#define TSKENCODERS		5		// saveFRAM_MOTOREncoders()
+#define TSKTRAJECTORY	6		// sample_TRAJECTORY()
+#define TSKWAYPOINTS	7		// check_WAYPOINTS()
+#define TSKSNAPSHOT		8		// check_SNAPSHOT()
+#define TSKWATCH		9		// check_WATCH()
+#define TSKPOWERFAIL	10		// save_POWERFAIL()
+#define TSKALARM		11		// check_ALARM()
+#define TSKBUS			12		// release_BUS() left owned, runs deferred jobs
+#define TSKWDTREPORT	13		// report_WDT()
+#define NTASKS			14
+
+// Trace points at the known places a task can hang
+#define TRCNONE			0
+#define TRCTWIREAD		1		// read_TWI, readlast_TWI waiting for RIF
+#define TRCTWIWRITE		2		// write_TWI waiting for the previous write
+#define TRCADS1115		3		// read_ADS1115 waiting for the conversion
+#define TRCROBOCLAW		4		// RoboClaw reply
+#define TRCUSART0		5		// send_USART draining the USART0 buffer
+#define NTRACES			6
+
+#define TRACE_WDT(point)	(wdtTrace = (point))
+
+typedef struct {
+	uint16_t magic;				// WDTMAGIC if the rest is valid
+	uint8_t task,				// Task that overran
+	trace;						// Last trace point it passed
+	uint16_t seconds;			// How long it had been running
+} WdtRecord;
+
+extern volatile uint8_t wdtTrace;
+extern uint8_t wdtPending;
+
+void begin_TASK(uint8_t);
+void check_WDT(void);
+void end_TASK(void);
+void init_WDT(void);
 void reboot(void);
+void report_WDT(void);
 
-#endif /* WDTH */
\ No newline at end of file
+#endif /* WDTH */
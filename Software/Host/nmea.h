@@ -0,0 +1,118 @@
+/*------------------------------------------------------------------------------
+nmea.h
+	specMech sentence helpers shared by the host tools. A sentence looks like
+		$S<id><TYPE>,<field>,...,<cid>*hh\r\n
+	where hh is the exclusive-or of every character between the $ and the *
+	(see checksum_NMEA in the firmware).
+------------------------------------------------------------------------------*/
+#ifndef HOST_NMEA_H
+#define HOST_NMEA_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace nmea {
+
+// Exclusive-or of the characters in s
+inline uint8_t checksum(std::string_view s)
+{
+	uint8_t sum = 0;
+	for (char c : s) {
+		sum ^= (uint8_t) c;
+	}
+	return sum;
+}
+
+// Strip the line ending. Returns the text between $ and * (the checksummed
+// part) and sets ok if the checksum is there and matches.
+inline std::string body(const std::string &line, bool &ok)
+{
+	std::string s = line;
+	while (!s.empty() && (s.back() == '\r' || s.back() == '\n')) {
+		s.pop_back();
+	}
+	ok = false;
+	if (s.empty() || s[0] != '$') {
+		return std::string();
+	}
+	size_t star = s.rfind('*');
+	if (star == std::string::npos || star + 3 != s.size()) {
+		return s.substr(1);
+	}
+	std::string b = s.substr(1, star - 1);
+	unsigned int hh;
+	if (std::sscanf(s.c_str() + star + 1, "%2X", &hh) == 1) {
+		ok = (checksum(b) == hh);
+	}
+	return b;
+}
+
+// body() without the copy: a view into line, for the sentences.hpp parsers
+inline std::string_view body_view(std::string_view line, bool &ok)
+{
+	while (!line.empty() && (line.back() == '\r' || line.back() == '\n')) {
+		line.remove_suffix(1);
+	}
+	ok = false;
+	if (line.empty() || line[0] != '$') {
+		return std::string_view();
+	}
+	size_t star = line.rfind('*');
+	if (star == std::string_view::npos || star + 3 != line.size()) {
+		return line.substr(1);
+	}
+	std::string_view b = line.substr(1, star - 1);
+	unsigned int hh = 0;
+	for (char c : line.substr(star + 1)) {
+		hh <<= 4;
+		if (c >= '0' && c <= '9') {
+			hh |= c - '0';
+		} else if (c >= 'A' && c <= 'F') {
+			hh |= c - 'A' + 10;
+		} else if (c >= 'a' && c <= 'f') {
+			hh |= c - 'a' + 10;
+		} else {
+			return b;
+		}
+	}
+	ok = (checksum(b) == hh);
+	return b;
+}
+
+// Rebuild a full sentence from its body
+inline std::string sentence(const std::string &b)
+{
+	char hh[8];
+	std::snprintf(hh, sizeof(hh), "*%02X\r\n", checksum(b));
+	return "$" + b + hh;
+}
+
+// Split a body (or anything else) on commas
+inline std::vector<std::string> split(const std::string &s)
+{
+	std::vector<std::string> fields;
+	size_t start = 0, comma;
+	while ((comma = s.find(',', start)) != std::string::npos) {
+		fields.push_back(s.substr(start, comma - start));
+		start = comma + 1;
+	}
+	fields.push_back(s.substr(start));
+	return fields;
+}
+
+// The sentence type of a body: "S2ENV,..." gives "ENV"
+inline std::string type(const std::string &b)
+{
+	if (b.size() < 3 || b[0] != 'S') {
+		return std::string();
+	}
+	size_t comma = b.find(',');
+	return b.substr(2, comma == std::string::npos ? std::string::npos : comma - 2);
+}
+
+} // namespace nmea
+
+#endif
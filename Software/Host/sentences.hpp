@@ -0,0 +1,487 @@
+/*------------------------------------------------------------------------------
+sentences.hpp
+	Generated by sentgen from Software/Host/sentences.def. Don't edit;
+	change the schema and run "make generate" in Software/Host.
+
+	Parsers for specMech sentence bodies (what nmea::body_view returns,
+	e.g. "S2ENV,..."). Text fields are views into the body, so the body
+	has to outlive the struct.
+------------------------------------------------------------------------------*/
+#ifndef HOST_SENTENCES_HPP
+#define HOST_SENTENCES_HPP
+
+#include <charconv>
+#include <string_view>
+
+namespace sentences {
+
+enum class Type {
+	Unknown,
+	CMD,
+	ENV,
+	ERR,
+	EXP,
+	MTR,
+	MTV,
+	ORI,
+	PNU,
+	QUE,
+	TIM,
+	VAC,
+	VER
+};
+
+// Walks the comma separated fields of a sentence
+struct Fields {
+	std::string_view rest;
+	bool done = false;
+
+	bool next(std::string_view &f)
+	{
+		if (done) {
+			return false;
+		}
+		size_t comma = rest.find(',');
+		if (comma == std::string_view::npos) {
+			f = rest;
+			done = true;
+		} else {
+			f = rest.substr(0, comma);
+			rest.remove_prefix(comma + 1);
+		}
+		return true;
+	}
+
+	// The last text field takes what's left, commas and all
+	bool tail(std::string_view &f)
+	{
+		if (done) {
+			return false;
+		}
+		f = rest;
+		done = true;
+		return true;
+	}
+
+	bool literal(std::string_view text)
+	{
+		std::string_view f;
+		return next(f) && f == text;
+	}
+
+	bool text(std::string_view &v)
+	{
+		return next(v);
+	}
+
+	bool character(char &c)
+	{
+		std::string_view f;
+		if (!next(f) || f.size() != 1) {
+			return false;
+		}
+		c = f[0];
+		return true;
+	}
+
+	template <typename T>
+	bool number(T &v)
+	{
+		std::string_view f;
+		if (!next(f)) {
+			return false;
+		}
+		while (!f.empty() && f[0] == ' ') {		// Fixed width padding
+			f.remove_prefix(1);
+		}
+		auto [end, ec] = std::from_chars(f.data(), f.data() + f.size(), v);
+		return ec == std::errc() && end == f.data() + f.size();
+	}
+};
+
+// Check the S<id><TYPE> header and point f at the first field
+inline bool header(Fields &f, std::string_view body, std::string_view type)
+{
+	if (body.size() < type.size() + 3 || body[0] != 'S' ||
+		body.substr(2, type.size()) != type || body[type.size() + 2] != ',') {
+		return false;
+	}
+	f.rest = body.substr(type.size() + 3);
+	f.done = false;
+	return true;
+}
+
+// The same for a sentence with short forms, S<id><TYPE>[:<letters>]
+inline bool header(Fields &f, std::string_view body, std::string_view type,
+	std::string_view &select)
+{
+	select = std::string_view();
+	if (body.size() < type.size() + 3 || body[0] != 'S' ||
+		body.substr(2, type.size()) != type) {
+		return false;
+	}
+	body.remove_prefix(type.size() + 2);
+	size_t comma = body.find(',');
+	if (comma == std::string_view::npos || (comma > 0 && body[0] != ':')) {
+		return false;
+	}
+	if (comma > 0) {
+		select = body.substr(1, comma - 1);
+	}
+	f.rest = body.substr(comma + 1);
+	f.done = false;
+	return true;
+}
+
+// Is field c in a sentence (empty select is every field)?
+inline bool want(std::string_view select, char c)
+{
+	return select.empty() || select.find(c) != std::string_view::npos;
+}
+
+inline Type type(std::string_view body)
+{
+	if (body.size() < 3 || body[0] != 'S') {
+		return Type::Unknown;
+	}
+	std::string_view t = body.substr(2, body.find_first_of(",:") - 2);	// MTR:p is an MTR
+	if (t == "CMD") {
+		return Type::CMD;
+	}
+	if (t == "ENV") {
+		return Type::ENV;
+	}
+	if (t == "ERR") {
+		return Type::ERR;
+	}
+	if (t == "EXP") {
+		return Type::EXP;
+	}
+	if (t == "MTR") {
+		return Type::MTR;
+	}
+	if (t == "MTV") {
+		return Type::MTV;
+	}
+	if (t == "ORI") {
+		return Type::ORI;
+	}
+	if (t == "PNU") {
+		return Type::PNU;
+	}
+	if (t == "QUE") {
+		return Type::QUE;
+	}
+	if (t == "TIM") {
+		return Type::TIM;
+	}
+	if (t == "VAC") {
+		return Type::VAC;
+	}
+	if (t == "VER") {
+		return Type::VER;
+	}
+	return Type::Unknown;
+}
+
+// CMD,<time>,<wait>,ms,<command>
+struct CMD {
+	std::string_view time{};
+	long wait{};
+	std::string_view command{};
+};
+
+inline bool parse(std::string_view body, CMD &s)
+{
+	Fields f;
+
+	if (!header(f, body, "CMD") ||
+		!f.text(s.time) ||
+		!f.number(s.wait) ||
+		!f.literal("ms") ||
+		!f.tail(s.command)) {
+		return false;
+	}
+	return f.done;
+}
+
+// ENV[:<th>],<time>[,<t0>,C]@t[,<h0>,%]@h[,<t1>,C]@t[,<h1>,%]@h[,<t2>,C]@t[,<h2>,%]@h[,<t3>,C]@t,<cid>
+struct ENV {
+	std::string_view select;	// Fields in a short form, empty for all
+	std::string_view time{};
+	double t0{};
+	double h0{};
+	double t1{};
+	double h1{};
+	double t2{};
+	double h2{};
+	double t3{};
+	std::string_view cid{};
+};
+
+inline bool parse(std::string_view body, ENV &s)
+{
+	Fields f;
+
+	if (!header(f, body, "ENV", s.select) ||
+		!f.text(s.time) ||
+		(want(s.select, 't') && (!f.number(s.t0) || !f.literal("C"))) ||
+		(want(s.select, 'h') && (!f.number(s.h0) || !f.literal("%"))) ||
+		(want(s.select, 't') && (!f.number(s.t1) || !f.literal("C"))) ||
+		(want(s.select, 'h') && (!f.number(s.h1) || !f.literal("%"))) ||
+		(want(s.select, 't') && (!f.number(s.t2) || !f.literal("C"))) ||
+		(want(s.select, 'h') && (!f.number(s.h2) || !f.literal("%"))) ||
+		(want(s.select, 't') && (!f.number(s.t3) || !f.literal("C"))) ||
+		!f.tail(s.cid)) {
+		return false;
+	}
+	return f.done;
+}
+
+// ERR,<code>[,<text>]
+struct ERR {
+	long code{};
+	std::string_view text{};
+	bool has_text = false;
+};
+
+inline bool parse(std::string_view body, ERR &s)
+{
+	Fields f;
+
+	if (!header(f, body, "ERR") ||
+		!f.number(s.code)) {
+		return false;
+	}
+	s.has_text = f.tail(s.text);
+	return true;
+}
+
+// EXP,<time>,<late>,ms,<wait>,ms,<cid>
+struct EXP {
+	std::string_view time{};
+	long late{};
+	long wait{};
+	std::string_view cid{};
+};
+
+inline bool parse(std::string_view body, EXP &s)
+{
+	Fields f;
+
+	if (!header(f, body, "EXP") ||
+		!f.text(s.time) ||
+		!f.number(s.late) ||
+		!f.literal("ms") ||
+		!f.number(s.wait) ||
+		!f.literal("ms") ||
+		!f.tail(s.cid)) {
+		return false;
+	}
+	return f.done;
+}
+
+// MTR[:<psc>],<time>,<axis>[,<position>,microns]@p[,<speed>,microns/sec]@s[,<current>,mA]@c,<cid>
+struct MTR {
+	std::string_view select;	// Fields in a short form, empty for all
+	std::string_view time{};
+	char axis{};
+	long position{};
+	long speed{};
+	long current{};
+	std::string_view cid{};
+};
+
+inline bool parse(std::string_view body, MTR &s)
+{
+	Fields f;
+
+	if (!header(f, body, "MTR", s.select) ||
+		!f.text(s.time) ||
+		!f.character(s.axis) ||
+		(want(s.select, 'p') && (!f.number(s.position) || !f.literal("microns"))) ||
+		(want(s.select, 's') && (!f.number(s.speed) || !f.literal("microns/sec"))) ||
+		(want(s.select, 'c') && (!f.number(s.current) || !f.literal("mA"))) ||
+		!f.tail(s.cid)) {
+		return false;
+	}
+	return f.done;
+}
+
+// MTV[:<vt>],<time>,<axis>[,<volts>,V]@v[,<temperature>,C]@t,<cid>
+struct MTV {
+	std::string_view select;	// Fields in a short form, empty for all
+	std::string_view time{};
+	char axis{};
+	double volts{};
+	double temperature{};
+	std::string_view cid{};
+};
+
+inline bool parse(std::string_view body, MTV &s)
+{
+	Fields f;
+
+	if (!header(f, body, "MTV", s.select) ||
+		!f.text(s.time) ||
+		!f.character(s.axis) ||
+		(want(s.select, 'v') && (!f.number(s.volts) || !f.literal("V"))) ||
+		(want(s.select, 't') && (!f.number(s.temperature) || !f.literal("C"))) ||
+		!f.tail(s.cid)) {
+		return false;
+	}
+	return f.done;
+}
+
+// ORI,<time>,<x>,<y>,<z>,<cid>
+struct ORI {
+	std::string_view time{};
+	double x{};
+	double y{};
+	double z{};
+	std::string_view cid{};
+};
+
+inline bool parse(std::string_view body, ORI &s)
+{
+	Fields f;
+
+	if (!header(f, body, "ORI") ||
+		!f.text(s.time) ||
+		!f.number(s.x) ||
+		!f.number(s.y) ||
+		!f.number(s.z) ||
+		!f.tail(s.cid)) {
+		return false;
+	}
+	return f.done;
+}
+
+// PNU,<time>,<shutter>,shutter,<left>,left,<right>,right,<air>,air,<cid>
+struct PNU {
+	std::string_view time{};
+	char shutter{};
+	char left{};
+	char right{};
+	char air{};
+	std::string_view cid{};
+};
+
+inline bool parse(std::string_view body, PNU &s)
+{
+	Fields f;
+
+	if (!header(f, body, "PNU") ||
+		!f.text(s.time) ||
+		!f.character(s.shutter) ||
+		!f.literal("shutter") ||
+		!f.character(s.left) ||
+		!f.literal("left") ||
+		!f.character(s.right) ||
+		!f.literal("right") ||
+		!f.character(s.air) ||
+		!f.literal("air") ||
+		!f.tail(s.cid)) {
+		return false;
+	}
+	return f.done;
+}
+
+// QUE,<time>,<commands>,<expired>,<last>,ms,<max>,ms,<cid>
+struct QUE {
+	std::string_view time{};
+	long commands{};
+	long expired{};
+	long last{};
+	long max{};
+	std::string_view cid{};
+};
+
+inline bool parse(std::string_view body, QUE &s)
+{
+	Fields f;
+
+	if (!header(f, body, "QUE") ||
+		!f.text(s.time) ||
+		!f.number(s.commands) ||
+		!f.number(s.expired) ||
+		!f.number(s.last) ||
+		!f.literal("ms") ||
+		!f.number(s.max) ||
+		!f.literal("ms") ||
+		!f.tail(s.cid)) {
+		return false;
+	}
+	return f.done;
+}
+
+// TIM,<time>,<settime>,set,<boottime>,boot,<cid>
+struct TIM {
+	std::string_view time{};
+	std::string_view settime{};
+	std::string_view boottime{};
+	std::string_view cid{};
+};
+
+inline bool parse(std::string_view body, TIM &s)
+{
+	Fields f;
+
+	if (!header(f, body, "TIM") ||
+		!f.text(s.time) ||
+		!f.text(s.settime) ||
+		!f.literal("set") ||
+		!f.text(s.boottime) ||
+		!f.literal("boot") ||
+		!f.tail(s.cid)) {
+		return false;
+	}
+	return f.done;
+}
+
+// VAC[:<rb>],<time>[,<red>,redvac]@r[,<blue>,bluevac]@b,<cid>
+struct VAC {
+	std::string_view select;	// Fields in a short form, empty for all
+	std::string_view time{};
+	double red{};
+	double blue{};
+	std::string_view cid{};
+};
+
+inline bool parse(std::string_view body, VAC &s)
+{
+	Fields f;
+
+	if (!header(f, body, "VAC", s.select) ||
+		!f.text(s.time) ||
+		(want(s.select, 'r') && (!f.number(s.red) || !f.literal("redvac"))) ||
+		(want(s.select, 'b') && (!f.number(s.blue) || !f.literal("bluevac"))) ||
+		!f.tail(s.cid)) {
+		return false;
+	}
+	return f.done;
+}
+
+// VER,<time>,<version>,<cid>
+struct VER {
+	std::string_view time{};
+	std::string_view version{};
+	std::string_view cid{};
+};
+
+inline bool parse(std::string_view body, VER &s)
+{
+	Fields f;
+
+	if (!header(f, body, "VER") ||
+		!f.text(s.time) ||
+		!f.text(s.version) ||
+		!f.tail(s.cid)) {
+		return false;
+	}
+	return f.done;
+}
+
+} // namespace sentences
+
+#endif
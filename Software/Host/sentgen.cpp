@@ -0,0 +1,667 @@
+/*------------------------------------------------------------------------------
+sentgen.cpp
+	Sentence generator. Reads the sentence schema and writes both ends of
+	the protocol from it:
+
+		sentgen <schema> <firmware dir> <host dir>
+
+	<firmware dir>/sentences.c, sentences.h
+		One format_<TYPE>() per sentence. Literal text (the type, units and
+		commas) is kept in flash and numbers are written as integers, fixed
+		point ones scaled by the schema's decimals with the decimal point put
+		in, so there's no printf and no floating point formatting.
+	<host dir>/sentences.hpp
+		One struct and parse() per sentence. The fields are string_views
+		into the sentence and numbers are converted with from_chars, so
+		parsing doesn't allocate.
+
+	See sentences.def for the schema format. "make generate" runs it with
+	the repository layout.
+------------------------------------------------------------------------------*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct Field {
+	std::string name;
+	char kind = 's';				// s, c, d, or f
+	int width = 0, decimals = 0;	// For f
+	std::string unit;				// Literal field after the value, or empty
+	bool optional = false;
+	char select = '\0';				// Letter that asks for it in a short report
+};
+
+struct Sentence {
+	std::string type;
+	std::vector<Field> fields;
+	std::string selectors;			// The fields' select letters, in order
+	int line = 0;
+};
+
+static const char *schemaName;
+
+static void die(int line, const char *why, const std::string &what)
+{
+	std::fprintf(stderr, "sentgen: %s:%d: %s (%s)\n", schemaName, line, why,
+		what.c_str());
+	std::exit(1);
+}
+
+static std::vector<Sentence> readSchema(const char *path)
+{
+	std::ifstream in(path);
+	std::vector<Sentence> sentences;
+	std::string text, token;
+	int line = 0;
+
+	if (!in) {
+		std::fprintf(stderr, "sentgen: can't read %s\n", path);
+		std::exit(1);
+	}
+	while (std::getline(in, text)) {
+		line++;
+		if (!text.empty() && text.back() == '\r') {
+			text.pop_back();
+		}
+		if (text.empty() || text[0] == '#') {
+			continue;
+		}
+		std::istringstream words(text);
+		Sentence s;
+		s.line = line;
+		if (!(words >> s.type)) {
+			continue;
+		}
+		while (words >> token) {
+			Field f;
+			size_t colon = token.find(':');
+			if (colon == std::string::npos || colon == 0) {
+				die(line, "field needs name:kind", token);
+			}
+			f.name = token.substr(0, colon);
+			if (f.name.back() == '?') {
+				f.optional = true;
+				f.name.pop_back();
+			}
+			size_t at = f.name.find('@');
+			if (at != std::string::npos) {
+				if (at + 2 != f.name.size() || f.optional) {
+					die(line, "a select letter is name@x, not optional", token);
+				}
+				f.select = f.name[at + 1];
+				f.name.resize(at);
+				if (s.selectors.find(f.select) == std::string::npos) {
+					s.selectors += f.select;
+				}
+			}
+			std::string kind = token.substr(colon + 1);
+			size_t unit = kind.find(':');
+			if (unit != std::string::npos) {
+				f.unit = kind.substr(unit + 1);
+				kind.resize(unit);
+			}
+			if (kind == "s" || kind == "c" || kind == "d") {
+				f.kind = kind[0];
+			} else if (kind.size() > 1 && kind[0] == 'f' &&
+				std::sscanf(kind.c_str() + 1, "%d.%d", &f.width, &f.decimals) == 2 &&
+				f.decimals >= 0 && f.decimals < 10) {
+				f.kind = 'f';
+			} else {
+				die(line, "unknown kind", token);
+			}
+			if (f.optional && !f.unit.empty()) {
+				die(line, "an optional field can't have a unit", token);
+			}
+			s.fields.push_back(f);
+		}
+		if (s.fields.empty()) {
+			die(line, "sentence has no fields", s.type);
+		}
+		for (size_t i = 0; i + 1 < s.fields.size(); i++) {
+			if (s.fields[i].optional) {
+				die(line, "only the last field can be optional", s.fields[i].name);
+			}
+		}
+		sentences.push_back(s);
+	}
+	return sentences;
+}
+
+// The firmware argument for a field
+static std::string cArg(const Field &f)
+{
+	switch (f.kind) {
+		case 'c':
+			return "char " + f.name;
+		case 'd':
+			return "int32_t " + f.name;
+		case 'f':
+			return "float " + f.name;
+		default:
+			return "const char *" + f.name;
+	}
+}
+
+// The definition line, wrapped with a tab like the hand-written code
+static std::string cSignature(const Sentence &s)
+{
+	std::string sig = "uint8_t format_" + s.type + "(char *buf";
+	size_t start = 0;
+	if (!s.selectors.empty()) {
+		sig += ", const char *select";
+	}
+	for (const Field &f : s.fields) {
+		std::string arg = cArg(f);
+		if (sig.size() - start + arg.size() + 3 > 78) {
+			sig += ",\n\t" + arg;
+			start = sig.size() - arg.size() - 4;
+		} else {
+			sig += ", " + arg;
+		}
+	}
+	return sig + ")";
+}
+
+// The prototype, types only like the rest of the firmware headers
+static std::string cPrototype(const Sentence &s)
+{
+	std::string sig = "uint8_t format_" + s.type + "(char*";
+	if (!s.selectors.empty()) {
+		sig += ", const char*";
+	}
+	for (const Field &f : s.fields) {
+		std::string arg = cArg(f);
+		arg.resize(arg.size() - f.name.size());
+		while (arg.back() == ' ') {
+			arg.pop_back();
+		}
+		if (arg.back() == '*') {		// char*, not char *
+			arg.erase(arg.size() - 2, 1);
+		}
+		sig += ", " + arg;
+	}
+	return sig + ");";
+}
+
+// The sentence as it appears on the line, e.g. ENV,<time>,<t0>,C,...
+static std::string layout(const Sentence &s)
+{
+	std::string text = s.type;
+	if (!s.selectors.empty()) {
+		text += "[:<" + s.selectors + ">]";
+	}
+	for (const Field &f : s.fields) {
+		bool maybe = f.optional || f.select;
+		text += maybe ? "[," : ",";
+		text += "<" + f.name + ">";
+		if (!f.unit.empty()) {
+			text += "," + f.unit;
+		}
+		if (maybe) {
+			text += "]";
+			if (f.select) {
+				text += std::string("@") + f.select;
+			}
+		}
+	}
+	return text;
+}
+
+static std::string cString(const std::string &s)
+{
+	std::string out = "\"";
+	for (char c : s) {
+		if (c == '"' || c == '\\') {
+			out += '\\';
+		}
+		out += c;
+	}
+	return out + "\"";
+}
+
+static const char *banner =
+	"\tGenerated by sentgen from Software/Host/sentences.def. Don't edit;\n"
+	"\tchange the schema and run \"make generate\" in Software/Host.\n";
+
+static void writeFirmwareHeader(const std::vector<Sentence> &sentences,
+	std::ostream &out)
+{
+	out << "/*------------------------------------------------------------------------------\n"
+		"sentences.h\n" << banner <<
+		"------------------------------------------------------------------------------*/\n"
+		"#ifndef SENTENCESH\n#define SENTENCESH\n\n"
+		"// Is field c in a short report's select letters (NULL is every field)?\n"
+		"#define SNTWANT(select, c)\t(((select) == NULL) || (strchr((select), (c)) != NULL))\n\n"
+		"// Select letters for each sentence that has short forms\n";
+	for (const Sentence &s : sentences) {
+		if (!s.selectors.empty()) {
+			out << "#define SNTSELECT_" << s.type << "\t" << cString(s.selectors) << "\n";
+		}
+	}
+	out << "\n";
+	for (const Sentence &s : sentences) {
+		out << cPrototype(s) << "\n";
+	}
+	out << "char *put_SNTINT(char*, int32_t, uint8_t, uint8_t);\n"
+		"char *put_SNTTEXT(char*, const char*);\n"
+		"char *put_SNTTEXT_P(char*, const char*);\n"
+		"int32_t to_FIXED(float, uint8_t);\n\n#endif\n";
+}
+
+static void writeFirmwareSource(const std::vector<Sentence> &sentences,
+	std::ostream &out)
+{
+	out << "/*------------------------------------------------------------------------------\n"
+		"sentences.c\n" << banner <<
+		"\n"
+		"\tThe sentence formatters. Each one writes the sentence body (no $S<id>\n"
+		"\tor checksum, printLine adds those) into buf and returns its length.\n"
+		"\tReadings are turned into fixed point integers (to_FIXED) and written\n"
+		"\twith put_SNTINT, so printf's floating point support isn't needed.\n"
+		"------------------------------------------------------------------------------*/\n"
+		"\n#include \"globals.h\"\n#include <avr/pgmspace.h>\n#include \"sentences.h\"\n";
+
+	for (const Sentence &s : sentences) {
+		std::string literal = s.type;
+		out << "\n/*------------------------------------------------------------------------------\n"
+			<< cSignature(s) << "\n\t" << layout(s) << "\n";
+		if (!s.selectors.empty()) {
+			out << "\tselect is NULL for every field, or the letters of the fields wanted.\n"
+				"\tA short sentence's type is marked with them (" << s.type << ":"
+				<< s.selectors.substr(0, 1) << ").\n";
+		}
+		out << "------------------------------------------------------------------------------*/\n"
+			<< cSignature(s) << "\n{\n\n\tchar *p;\n\n\tp = buf;\n";
+		if (!s.selectors.empty()) {
+			out << "\tp = put_SNTTEXT_P(p, PSTR(" << cString(literal) << "));\n"
+				"\tif (select != NULL) {\n\t\t*p++ = ':';\n"
+				"\t\tp = put_SNTTEXT(p, select);\n\t}\n";
+			literal.clear();
+		}
+		for (size_t i = 0; i < s.fields.size(); i++) {
+			const Field &f = s.fields[i];
+			std::string indent = "\t";
+			if (f.optional || f.select) {	// Its comma and unit go with it
+				if (!literal.empty()) {
+					out << "\tp = put_SNTTEXT_P(p, PSTR(" << cString(literal) << "));\n";
+				}
+				if (f.optional) {
+					out << "\tif (" << f.name << " != NULL) {\n";
+				} else {
+					out << "\tif (SNTWANT(select, '" << f.select << "')) {\n";
+				}
+				indent = "\t\t";
+			}
+			literal += ",";
+			out << indent << "p = put_SNTTEXT_P(p, PSTR(" << cString(literal) << "));\n";
+			switch (f.kind) {
+				case 'c':
+					out << indent << "*p++ = " << f.name << ";\n";
+					break;
+				case 'd':
+					out << indent << "p = put_SNTINT(p, " << f.name << ", 0, 0);\n";
+					break;
+				case 'f':
+					out << indent << "p = put_SNTINT(p, to_FIXED(" << f.name << ", "
+						<< f.decimals << "), " << f.width << ", " << f.decimals << ");\n";
+					break;
+				default:
+					out << indent << "p = put_SNTTEXT(p, " << f.name << ");\n";
+					break;
+			}
+			literal.clear();
+			if (!f.unit.empty()) {
+				literal = "," + f.unit;
+			}
+			if (f.optional || f.select) {
+				if (!literal.empty()) {
+					out << indent << "p = put_SNTTEXT_P(p, PSTR(" << cString(literal) << "));\n";
+				}
+				out << "\t}\n";
+				literal.clear();
+			}
+		}
+		if (!literal.empty()) {
+			out << "\tp = put_SNTTEXT_P(p, PSTR(" << cString(literal) << "));\n";
+		}
+		out << "\t*p = '\\0';\n\n\treturn((uint8_t) (p - buf));\n\n}\n";
+	}
+
+	out << R"(
+/*------------------------------------------------------------------------------
+char *put_SNTINT(char *p, int32_t value, uint8_t width, uint8_t decimals)
+	Write an integer, or a fixed point number with the decimal point put in
+	decimals digits from the right, padded with spaces to at least width
+	characters. Returns the end of what was written.
+------------------------------------------------------------------------------*/
+char *put_SNTINT(char *p, int32_t value, uint8_t width, uint8_t decimals)
+{
+
+	char digits[12];
+	uint8_t n, len;
+	uint32_t u;
+
+	u = (value < 0) ? -((uint32_t) value) : (uint32_t) value;
+	n = 0;
+	do {								// At least one digit before the point
+		digits[n++] = '0' + (u % 10);
+		u /= 10;
+	} while ((u != 0) || (n <= decimals));
+
+	len = n + (decimals ? 1 : 0) + ((value < 0) ? 1 : 0);
+	for (; len < width; len++) {
+		*p++ = ' ';
+	}
+	if (value < 0) {
+		*p++ = '-';
+	}
+	while (n > 0) {
+		*p++ = digits[--n];
+		if (decimals && (n == decimals)) {
+			*p++ = '.';
+		}
+	}
+
+	return(p);
+
+}
+
+/*------------------------------------------------------------------------------
+char *put_SNTTEXT(char *p, const char *text)
+	Copy a string. Returns the end of what was written.
+------------------------------------------------------------------------------*/
+char *put_SNTTEXT(char *p, const char *text)
+{
+
+	while (*text != '\0') {
+		*p++ = *text++;
+	}
+
+	return(p);
+
+}
+
+/*------------------------------------------------------------------------------
+char *put_SNTTEXT_P(char *p, const char *text)
+	Copy a string from flash. Returns the end of what was written.
+------------------------------------------------------------------------------*/
+char *put_SNTTEXT_P(char *p, const char *text)
+{
+
+	char c;
+
+	while ((c = pgm_read_byte(text++)) != '\0') {
+		*p++ = c;
+	}
+
+	return(p);
+
+}
+
+/*------------------------------------------------------------------------------
+int32_t to_FIXED(float value, uint8_t decimals)
+	A reading as a fixed point integer: value times 10^decimals, rounded
+------------------------------------------------------------------------------*/
+int32_t to_FIXED(float value, uint8_t decimals)
+{
+
+	while (decimals-- > 0) {
+		value *= 10.0;
+	}
+
+	return((int32_t) ((value < 0.0) ? (value - 0.5) : (value + 0.5)));
+
+}
+)";
+}
+
+// The host type for a field
+static std::string cppType(const Field &f)
+{
+	switch (f.kind) {
+		case 'c':
+			return "char";
+		case 'd':
+			return "long";
+		case 'f':
+			return "double";
+		default:
+			return "std::string_view";
+	}
+}
+
+static void writeHostHeader(const std::vector<Sentence> &sentences,
+	std::ostream &out)
+{
+	out << "/*------------------------------------------------------------------------------\n"
+		"sentences.hpp\n" << banner <<
+		"\n"
+		"\tParsers for specMech sentence bodies (what nmea::body_view returns,\n"
+		"\te.g. \"S2ENV,...\"). Text fields are views into the body, so the body\n"
+		"\thas to outlive the struct.\n"
+		"------------------------------------------------------------------------------*/\n"
+		"#ifndef HOST_SENTENCES_HPP\n#define HOST_SENTENCES_HPP\n\n"
+		"#include <charconv>\n#include <string_view>\n\n"
+		"namespace sentences {\n\n"
+		"enum class Type {\n\tUnknown";
+	for (const Sentence &s : sentences) {
+		out << ",\n\t" << s.type;
+	}
+	out << "\n};\n\n" << R"(// Walks the comma separated fields of a sentence
+struct Fields {
+	std::string_view rest;
+	bool done = false;
+
+	bool next(std::string_view &f)
+	{
+		if (done) {
+			return false;
+		}
+		size_t comma = rest.find(',');
+		if (comma == std::string_view::npos) {
+			f = rest;
+			done = true;
+		} else {
+			f = rest.substr(0, comma);
+			rest.remove_prefix(comma + 1);
+		}
+		return true;
+	}
+
+	// The last text field takes what's left, commas and all
+	bool tail(std::string_view &f)
+	{
+		if (done) {
+			return false;
+		}
+		f = rest;
+		done = true;
+		return true;
+	}
+
+	bool literal(std::string_view text)
+	{
+		std::string_view f;
+		return next(f) && f == text;
+	}
+
+	bool text(std::string_view &v)
+	{
+		return next(v);
+	}
+
+	bool character(char &c)
+	{
+		std::string_view f;
+		if (!next(f) || f.size() != 1) {
+			return false;
+		}
+		c = f[0];
+		return true;
+	}
+
+	template <typename T>
+	bool number(T &v)
+	{
+		std::string_view f;
+		if (!next(f)) {
+			return false;
+		}
+		while (!f.empty() && f[0] == ' ') {		// Fixed width padding
+			f.remove_prefix(1);
+		}
+		auto [end, ec] = std::from_chars(f.data(), f.data() + f.size(), v);
+		return ec == std::errc() && end == f.data() + f.size();
+	}
+};
+
+// Check the S<id><TYPE> header and point f at the first field
+inline bool header(Fields &f, std::string_view body, std::string_view type)
+{
+	if (body.size() < type.size() + 3 || body[0] != 'S' ||
+		body.substr(2, type.size()) != type || body[type.size() + 2] != ',') {
+		return false;
+	}
+	f.rest = body.substr(type.size() + 3);
+	f.done = false;
+	return true;
+}
+
+// The same for a sentence with short forms, S<id><TYPE>[:<letters>]
+inline bool header(Fields &f, std::string_view body, std::string_view type,
+	std::string_view &select)
+{
+	select = std::string_view();
+	if (body.size() < type.size() + 3 || body[0] != 'S' ||
+		body.substr(2, type.size()) != type) {
+		return false;
+	}
+	body.remove_prefix(type.size() + 2);
+	size_t comma = body.find(',');
+	if (comma == std::string_view::npos || (comma > 0 && body[0] != ':')) {
+		return false;
+	}
+	if (comma > 0) {
+		select = body.substr(1, comma - 1);
+	}
+	f.rest = body.substr(comma + 1);
+	f.done = false;
+	return true;
+}
+
+// Is field c in a sentence (empty select is every field)?
+inline bool want(std::string_view select, char c)
+{
+	return select.empty() || select.find(c) != std::string_view::npos;
+}
+
+)";
+
+	out << "inline Type type(std::string_view body)\n{\n"
+		"\tif (body.size() < 3 || body[0] != 'S') {\n\t\treturn Type::Unknown;\n\t}\n"
+		"\tstd::string_view t = body.substr(2, body.find_first_of(\",:\") - 2);"
+		"\t// MTR:p is an MTR\n";
+	for (const Sentence &s : sentences) {
+		out << "\tif (t == \"" << s.type << "\") {\n\t\treturn Type::" << s.type
+			<< ";\n\t}\n";
+	}
+	out << "\treturn Type::Unknown;\n}\n";
+
+	for (const Sentence &s : sentences) {
+		out << "\n// " << layout(s) << "\nstruct " << s.type << " {\n";
+		if (!s.selectors.empty()) {
+			out << "\tstd::string_view select;\t// Fields in a short form, empty for all\n";
+		}
+		for (const Field &f : s.fields) {
+			out << "\t" << cppType(f) << " " << f.name << "{};\n";
+			if (f.optional) {
+				out << "\tbool has_" << f.name << " = false;\n";
+			}
+		}
+		out << "};\n\ninline bool parse(std::string_view body, " << s.type
+			<< " &s)\n{\n\tFields f;\n\n\tif (!header(f, body, \"" << s.type << "\""
+			<< (s.selectors.empty() ? ")" : ", s.select)");
+		const Field *optional = nullptr;
+		for (size_t i = 0; i < s.fields.size(); i++) {
+			const Field &f = s.fields[i];
+			bool last = (i + 1 == s.fields.size());
+			if (f.optional) {
+				optional = &f;
+				continue;
+			}
+			out << " ||\n\t\t";
+			if (f.select) {
+				out << "(want(s.select, '" << f.select << "') && (";
+			}
+			switch (f.kind) {
+				case 'c':
+					out << "!f.character(s." << f.name << ")";
+					break;
+				case 'd':
+				case 'f':
+					out << "!f.number(s." << f.name << ")";
+					break;
+				default:
+					out << (last ? "!f.tail(s." : "!f.text(s.") << f.name << ")";
+					break;
+			}
+			if (!f.unit.empty()) {
+				out << " ||" << (f.select ? " " : "\n\t\t") << "!f.literal("
+					<< cString(f.unit) << ")";
+			}
+			if (f.select) {
+				out << "))";
+			}
+		}
+		out << ") {\n\t\treturn false;\n\t}\n";
+		if (optional != nullptr) {
+			out << "\ts.has_" << optional->name << " = f.tail(s." << optional->name
+				<< ");\n\treturn true;\n}\n";
+		} else {
+			out << "\treturn f.done;\n}\n";
+		}
+	}
+	out << "\n} // namespace sentences\n\n#endif\n";
+}
+
+// Write a file only if it changed, so make doesn't rebuild for nothing
+static void update(const std::string &path, const std::string &text)
+{
+	std::ifstream in(path, std::ios::binary);
+	std::stringstream old;
+	old << in.rdbuf();
+	if (in && old.str() == text) {
+		return;
+	}
+	std::ofstream out(path, std::ios::binary);
+	out << text;
+	if (!out) {
+		std::fprintf(stderr, "sentgen: can't write %s\n", path.c_str());
+		std::exit(1);
+	}
+	std::printf("sentgen: wrote %s\n", path.c_str());
+}
+
+int main(int argc, char **argv)
+{
+	if (argc != 4) {
+		std::fprintf(stderr, "usage: sentgen <schema> <firmware dir> <host dir>\n");
+		return 2;
+	}
+	schemaName = argv[1];
+	std::vector<Sentence> sentences = readSchema(argv[1]);
+	std::string firmware = argv[2], host = argv[3];
+	std::ostringstream h, c, hpp;
+
+	writeFirmwareHeader(sentences, h);
+	writeFirmwareSource(sentences, c);
+	writeHostHeader(sentences, hpp);
+	update(firmware + "/sentences.h", h.str());
+	update(firmware + "/sentences.c", c.str());
+	update(host + "/sentences.hpp", hpp.str());
+	return 0;
+}
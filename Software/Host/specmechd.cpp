@@ -0,0 +1,877 @@
+/*------------------------------------------------------------------------------
+specmechd.cpp
+	Caching proxy for the specMech link. The XPort takes one TCP session, so
+	specmechd holds it and local programs connect to specmechd instead:
+
+		specmechd -c <host:port | /dev/ttyX> [-l port] [-a maxage] [-p depth]
+			[-t timeout] [-v]
+
+	Clients send command lines exactly as they would to specMech. Each
+	command gets its sentences back followed by a status line, ">" if it
+	worked or "?" if it failed. Commands from all clients are put in one
+	queue and kept in the controller's command stack up to <depth> entries
+	at a time. A compound line (cs&cl&cr) takes an entry per command.
+
+	Replies to plain report commands (ra, re, rv, ...) are cached and a
+	repeat within <maxage> seconds is answered from the cache, with the
+	client's command ID put in. Identical reports already waiting share one
+	trip to the controller. A line with anything but reports on it (cs,
+	ma1000, ...) starts a new epoch: reports from before it aren't answered
+	from the cache or shared with reports sent after it. Unsolicited sentences (EVT) refresh the cache,
+	go to every client that asked for events, and are acknowledged (ae)
+	here so the outbox drains.
+
+	An rj dump comes after its > as TRB frames (a sentence and its binary
+	samples) that end with the TRJ end sentence. They go to the client that
+	sent the rj.
+
+	specmechd answers the reboot prompt (!) itself, puts the session in
+	machine mode (ssmachine), and resends commands that were turned away
+	while the controller waited for the acknowledge.
+
+	A command that times out is still in the controller's stack and will
+	answer late. So after a timeout specmechd sends rV with its own command
+	ID and throws away everything before that reply, rather than matching
+	the late output to the commands after it.
+
+	Lines starting with a dot are for specmechd:
+		.events on|off	Get (or stop getting) unsolicited sentences
+		.stats			Counters
+------------------------------------------------------------------------------*/
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "nmea.h"
+
+static const size_t STACKSLOTS = 9;		// CSTACKSIZE is 10, one stays empty
+
+using Clock = std::chrono::steady_clock;
+
+enum Kind { CLIENT, REBOOTACK, SESSION, EVENTACK, SYNC };
+
+struct Waiter {
+	int client;						// -1 once the client has gone
+	std::string cid;
+};
+
+struct Request {
+	Kind kind = CLIENT;
+	std::string line;				// Command line without the \r
+	std::string key;				// Cache key ("re", "ra", ...) or empty
+	std::vector<Waiter> waiters;
+	std::vector<std::string> raw;	// Reply as received (lines and binary blocks)
+	std::vector<std::string> bodies;	// Reply sentence bodies
+	Clock::time_point sent;
+	unsigned long epoch = 0;		// State changes queued before this one
+};
+
+struct Entry {
+	std::vector<std::string> bodies;
+	Clock::time_point when;
+	unsigned long epoch;
+};
+
+struct Client {
+	int fd;
+	std::string in, out;
+	bool events = false;
+};
+
+static struct {
+	std::string target;
+	int port = 5010;
+	double maxAge = 2.0;
+	size_t depth = 4;
+	int timeout = 15;
+	bool verbose = false;
+} opt;
+
+static struct {
+	unsigned long sent, hits, shared, events, badsum, timeouts, reboots;
+} stats;
+
+static int linkfd = -1;
+static Clock::time_point nextConnect;
+static std::string linkIn;				// Partial line from specMech
+static std::string rawBlock;			// Binary block being collected (TRB)
+static size_t rawLeft;					// Bytes still to come in rawBlock
+static std::vector<Waiter> dumpTo;		// Clients getting an rj dump
+static char specId = '2';
+
+static std::map<int, Client> clients;
+static std::deque<Request> waiting, inflight, retry;
+static std::map<std::string, Entry> cache;
+static std::map<std::string, std::string> typeKey;	// "ENV" or "MTR,a" -> cache key
+static bool ackQueued, rebootAckQueued;
+static long lastSeq = -1;
+static unsigned long epoch;				// Lines queued that change state
+static bool syncing;					// Dropping output until syncCid's reply
+static std::string syncCid;
+static unsigned long syncCount;
+
+static void say(const char *fmt, ...)
+{
+	if (!opt.verbose) {
+		return;
+	}
+	va_list ap;
+	va_start(ap, fmt);
+	std::vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	std::fputc('\n', stderr);
+}
+
+/*------------------------------------------------------------------------------
+Client output
+------------------------------------------------------------------------------*/
+static void flushClient(Client &c)
+{
+	while (!c.out.empty()) {
+		ssize_t n = send(c.fd, c.out.data(), c.out.size(), MSG_NOSIGNAL);
+		if (n <= 0) {
+			return;			// Try again on POLLOUT (or drop on error there)
+		}
+		c.out.erase(0, n);
+	}
+}
+
+static void toClient(int fd, const std::string &s)
+{
+	auto it = clients.find(fd);
+	if (it == clients.end()) {
+		return;
+	}
+	it->second.out += s;
+	flushClient(it->second);
+}
+
+static void toSubscribers(const std::string &s)
+{
+	for (auto &kv : clients) {
+		if (kv.second.events) {
+			kv.second.out += s;
+			flushClient(kv.second);
+		}
+	}
+}
+
+static void forgetClient(int fd)
+{
+	for (auto *q : {&waiting, &inflight, &retry}) {
+		for (auto &r : *q) {
+			for (auto &w : r.waiters) {
+				if (w.client == fd) {
+					w.client = -1;
+				}
+			}
+		}
+	}
+	for (auto &w : dumpTo) {
+		if (w.client == fd) {
+			w.client = -1;
+		}
+	}
+	close(fd);
+	clients.erase(fd);
+}
+
+/*------------------------------------------------------------------------------
+Sentences
+------------------------------------------------------------------------------*/
+
+// Put a different command ID in the last field of a body
+static std::string recid(const std::string &body, const std::string &cid)
+{
+	size_t comma = body.rfind(',');
+	if (comma == std::string::npos) {
+		return body;
+	}
+	return body.substr(0, comma + 1) + cid;
+}
+
+// What a sentence refreshes in the cache: its type, plus the motor for
+// the per-motor sentences
+static std::string typeOf(const std::string &body)
+{
+	std::string t = nmea::type(body);
+	if (t == "MTR" || t == "MTV") {
+		std::vector<std::string> f = nmea::split(body);
+		if (f.size() > 2) {
+			t += "," + f[2];
+		}
+	}
+	return t;
+}
+
+// The command ID at the end of a body
+static std::string lastField(const std::string &body)
+{
+	size_t comma = body.rfind(',');
+	return (comma == std::string::npos) ? std::string() : body.substr(comma + 1);
+}
+
+// Does a command line do anything besides report? Each command on a
+// compound line is checked.
+static bool changesState(const std::string &cmd)
+{
+	size_t start = 0, end;
+
+	do {
+		end = cmd.find_first_of("&|", start);
+		std::string part = cmd.substr(start, end == std::string::npos ? end : end - start);
+		size_t first = part.find_first_not_of(' ');
+		if (first != std::string::npos && part[first] != 'r') {
+			return true;
+		}
+		start = end + 1;
+	} while (end != std::string::npos);
+	return false;
+}
+
+// Send part of an rj dump to the client that asked for it
+static void toDump(const std::string &s)
+{
+	bool sent = false;
+	for (auto &w : dumpTo) {
+		if (w.client >= 0) {
+			toClient(w.client, s);
+			sent = true;
+		}
+	}
+	if (!sent) {
+		toSubscribers(s);
+	}
+}
+
+static void deliver(Request &r, char status)
+{
+	for (auto &w : r.waiters) {
+		if (w.client < 0) {
+			continue;
+		}
+		std::string out;
+		if (!r.key.empty()) {
+			for (auto &b : r.bodies) {
+				out += nmea::sentence(recid(b, w.cid));
+			}
+		} else {
+			for (auto &s : r.raw) {
+				out += s;
+			}
+		}
+		out += status;
+		out += '\n';
+		toClient(w.client, out);
+	}
+}
+
+static void fail(Request &r, const char *why)
+{
+	r.raw.clear();
+	r.bodies.clear();
+	r.key.clear();
+	r.raw.push_back(std::string("# ") + why + "\n");
+	deliver(r, '?');
+}
+
+static void failAll(const char *why)
+{
+	for (auto *q : {&inflight, &retry}) {
+		for (auto &r : *q) {
+			fail(r, why);
+		}
+		q->clear();
+	}
+	rawLeft = 0;
+	linkIn.clear();
+}
+
+/*------------------------------------------------------------------------------
+Controller link
+------------------------------------------------------------------------------*/
+static void closeLink(const char *why)
+{
+	say("link closed: %s", why);
+	if (linkfd >= 0) {
+		close(linkfd);
+	}
+	linkfd = -1;
+	failAll(why);
+	for (auto &r : waiting) {		// Internal requests are requeued on connect
+		if (r.kind != CLIENT) {
+			r.waiters.clear();
+		}
+	}
+	std::deque<Request> keep;
+	for (auto &r : waiting) {
+		if (r.kind == CLIENT) {
+			keep.push_back(r);
+		}
+	}
+	waiting.swap(keep);
+	ackQueued = rebootAckQueued = false;
+	syncing = false;
+	nextConnect = Clock::now() + std::chrono::seconds(5);
+}
+
+// Give up on what's in flight after a timeout. The controller still has
+// those commands, so drop its output until the reply to a marker command.
+static void resync(void)
+{
+	failAll("specMech timeout");
+	syncCid = "Z" + std::to_string(++syncCount % 10000000);	// CIDSIZE is 9
+	Request sync;
+	sync.kind = SYNC;
+	sync.line = "rV;" + syncCid;
+	waiting.push_front(sync);
+	syncing = true;
+	say("resync with %s", syncCid.c_str());
+}
+
+static int openSerial(const std::string &path)
+{
+	int fd = open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (fd < 0) {
+		return -1;
+	}
+	struct termios t;
+	if (tcgetattr(fd, &t) == 0) {
+		cfmakeraw(&t);
+		cfsetispeed(&t, B115200);	// USART0 rate in init_USART
+		cfsetospeed(&t, B115200);
+		t.c_cflag |= CLOCAL | CREAD;
+		tcsetattr(fd, TCSANOW, &t);
+	}
+	return fd;
+}
+
+static int openTCP(const std::string &target)
+{
+	size_t colon = target.rfind(':');
+	if (colon == std::string::npos) {
+		return -1;
+	}
+	std::string host = target.substr(0, colon), port = target.substr(colon + 1);
+	struct addrinfo hints, *res;
+	std::memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res) != 0) {
+		return -1;
+	}
+	int fd = -1;
+	for (struct addrinfo *a = res; a; a = a->ai_next) {
+		fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+		if (fd < 0) {
+			continue;
+		}
+		if (connect(fd, a->ai_addr, a->ai_addrlen) == 0) {
+			break;
+		}
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(res);
+	if (fd >= 0) {
+		int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	}
+	return fd;
+}
+
+static void queueRebootAck(void)
+{
+	if (rebootAckQueued) {
+		return;
+	}
+	Request ack;
+	ack.kind = REBOOTACK;
+	ack.line = "!";
+	waiting.push_front(ack);
+	rebootAckQueued = true;
+}
+
+static void openLink(void)
+{
+	linkfd = (opt.target.find('/') != std::string::npos) ?
+		openSerial(opt.target) : openTCP(opt.target);
+	if (linkfd < 0) {
+		say("can't open %s: %s", opt.target.c_str(), std::strerror(errno));
+		nextConnect = Clock::now() + std::chrono::seconds(5);
+		return;
+	}
+	say("link open to %s", opt.target.c_str());
+	linkIn.clear();
+	rawLeft = 0;
+	cache.clear();
+	queueRebootAck();			// "!" alone is harmless if already acknowledged
+}
+
+static void writeLink(const std::string &s)
+{
+	size_t done = 0;
+	while (done < s.size() && linkfd >= 0) {
+		ssize_t n = write(linkfd, s.data() + done, s.size() - done);
+		if (n > 0) {
+			done += n;
+		} else if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+			struct pollfd p = {linkfd, POLLOUT, 0};
+			poll(&p, 1, 100);
+		} else {
+			closeLink("write failed");
+		}
+	}
+}
+
+// pcmd entries a line takes: one per command. & and | in the command ID
+// or checksum don't count.
+static size_t slots(const std::string &line)
+{
+	std::string cmd = line.substr(0, line.find_first_of(";*"));
+	return 1 + std::count_if(cmd.begin(), cmd.end(),
+		[](char c) { return c == '&' || c == '|'; });
+}
+
+// Send queued commands while there's room in the controller's stack
+static void pump(void)
+{
+	while ((linkfd >= 0) && !waiting.empty()) {
+		size_t used = 0, need = slots(waiting.front().line);
+		for (auto &r : inflight) {
+			used += slots(r.line);
+		}
+		if (need > STACKSLOTS) {		// The controller would drop it
+			Request r = waiting.front();
+			waiting.pop_front();
+			fail(r, "too many commands on the line");
+			continue;
+		}
+		if (!inflight.empty() && ((used + need) > opt.depth)) {
+			break;
+		}
+		Request r = waiting.front();
+		waiting.pop_front();
+		if (r.kind == EVENTACK) {
+			ackQueued = false;
+			r.line = "ae" + std::to_string(lastSeq);
+		}
+		r.sent = Clock::now();
+		inflight.push_back(r);
+		stats.sent++;
+		say("> %s", r.line.c_str());
+		writeLink(r.line + "\r");
+	}
+}
+
+// A status prompt (> or ?) finished the oldest command
+static void complete(char status)
+{
+	if (inflight.empty()) {
+		return;
+	}
+	Request r = inflight.front();
+	inflight.pop_front();
+
+	if (r.kind == SYNC) {
+		return;
+	}
+
+	if (r.kind == REBOOTACK) {
+		rebootAckQueued = false;
+		for (auto it = retry.rbegin(); it != retry.rend(); ++it) {
+			waiting.push_front(*it);
+		}
+		retry.clear();
+		Request session;
+		session.kind = SESSION;
+		session.line = "ssmachine";
+		waiting.push_front(session);
+		return;
+	}
+
+	if ((status == '>') && !r.key.empty() && !r.bodies.empty()) {
+		cache[r.key] = Entry{r.bodies, Clock::now(), r.epoch};
+		for (auto &b : r.bodies) {
+			typeKey[typeOf(b)] = r.key;
+		}
+	}
+	deliver(r, status);
+}
+
+// The controller rebooted and turned the oldest command away
+static void rejected(void)
+{
+	if (!rebootAckQueued) {
+		stats.reboots++;
+		cache.clear();
+	}
+	if (!inflight.empty()) {
+		Request r = inflight.front();
+		inflight.pop_front();
+		if (r.kind == CLIENT) {
+			r.raw.clear();
+			r.bodies.clear();
+			retry.push_back(r);
+		}
+	}
+	queueRebootAck();
+}
+
+static void linkLine(const std::string &line)
+{
+	bool ok;
+	std::string body = nmea::body(line, ok);
+
+	if (!ok) {
+		stats.badsum++;
+	}
+	if (body.size() > 1) {
+		specId = body[1];
+	}
+	std::string type = nmea::type(body);
+
+	if (type == "EVT") {					// S2EVT,<seq>,<sentence>
+		size_t c1 = body.find(','), c2 = body.find(',', c1 + 1);
+		if (c2 != std::string::npos) {
+			lastSeq = std::atol(body.substr(c1 + 1, c2 - c1 - 1).c_str());
+			std::string inner = std::string("S") + specId + body.substr(c2 + 1);
+			auto k = typeKey.find(typeOf(inner));
+			if (k != typeKey.end()) {
+				cache[k->second] = Entry{{inner}, Clock::now(), epoch};
+			}
+			if (!ackQueued) {
+				Request ack;
+				ack.kind = EVENTACK;
+				waiting.push_back(ack);
+				ackQueued = true;
+			}
+		}
+		stats.events++;
+		toSubscribers(line);
+		return;
+	}
+
+	if (type == "TRB") {					// TRB,<offset>,<nbytes>,<ID> and the bytes
+		std::vector<std::string> f = nmea::split(body);
+		if (f.size() > 2) {
+			rawLeft = std::strtoul(f[2].c_str(), nullptr, 10);
+			rawBlock.clear();
+		}
+		toDump(line);
+		return;
+	}
+
+	if (type == "TRJ") {					// Header with the rj reply, or the dump's end
+		std::vector<std::string> f = nmea::split(body);
+		if (f.size() > 2 && f[2] == "end") {
+			toDump(line);
+			dumpTo.clear();
+			return;
+		}
+		if (!syncing && !inflight.empty()) {
+			dumpTo = inflight.front().waiters;
+		}
+	}
+
+	if (syncing) {							// Late output for failed commands
+		if (lastField(body) == syncCid) {
+			say("resynced");
+			syncing = false;				// The > that follows is the marker's
+		}
+		return;
+	}
+
+	if (inflight.empty()) {
+		toSubscribers(line);
+		return;
+	}
+	inflight.front().raw.push_back(line);
+	inflight.front().bodies.push_back(body);
+}
+
+static void readLink(void)
+{
+	char buf[4096];
+	ssize_t n = read(linkfd, buf, sizeof(buf));
+
+	if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+		closeLink("read failed");
+		return;
+	}
+	for (ssize_t i = 0; i < n; i++) {
+		char c = buf[i];
+		if (rawLeft) {
+			rawBlock += c;
+			if (--rawLeft == 0) {
+				toDump(rawBlock);
+			}
+		} else if (linkIn.empty() && (c == '>' || c == '?')) {
+			if (!syncing) {
+				complete(c);
+			}
+		} else if (linkIn.empty() && c == '!') {
+			syncing = false;			// Rebooted, the old commands are gone
+			rejected();
+		} else if (linkIn.empty() && (c == '\r' || c == '\n')) {
+			continue;
+		} else {
+			linkIn += c;
+			if (c == '\n') {
+				linkLine(linkIn);
+				linkIn.clear();
+			}
+		}
+	}
+	pump();
+}
+
+/*------------------------------------------------------------------------------
+Client input
+------------------------------------------------------------------------------*/
+static void meta(int fd, const std::string &line)
+{
+	char buf[256];
+
+	if (line == ".events on") {
+		clients[fd].events = true;
+	} else if (line == ".events off") {
+		clients[fd].events = false;
+	} else if (line == ".stats") {
+		std::snprintf(buf, sizeof(buf),
+			"# sent %lu cachehits %lu shared %lu events %lu badchecksum %lu "
+			"timeouts %lu reboots %lu clients %zu queued %zu\n",
+			stats.sent, stats.hits, stats.shared, stats.events, stats.badsum,
+			stats.timeouts, stats.reboots, clients.size(),
+			waiting.size() + inflight.size());
+		toClient(fd, buf);
+	} else {
+		toClient(fd, "# unknown\n?\n");
+		return;
+	}
+	toClient(fd, ">\n");
+}
+
+static void clientLine(int fd, std::string line)
+{
+	while (!line.empty() && (line.back() == '\r' || line.back() == '\n')) {
+		line.pop_back();
+	}
+	if (line.empty()) {
+		return;
+	}
+	if (line[0] == '.') {
+		meta(fd, line);
+		return;
+	}
+
+	// Command ID and the part before it (the *hh checksum doesn't count)
+	std::string cmd = line.substr(0, line.find('*'));
+	std::string cid;
+	size_t semi = cmd.find(';');
+	if (semi != std::string::npos) {
+		cid = cmd.substr(semi + 1);
+		cmd.erase(semi);
+	}
+
+	if (changesState(cmd)) {
+		epoch++;
+	}
+
+	Request r;
+	r.line = line;
+	r.epoch = epoch;
+	r.waiters.push_back(Waiter{fd, cid});
+	if ((cmd.size() == 2) && (cmd[0] == 'r') && std::isalpha((unsigned char) cmd[1]) &&
+		(cmd[1] != 'j') && (cmd[1] != 'x')) {	// Dumps aren't cached
+		r.key = cmd;
+	}
+
+	if (!r.key.empty()) {
+		auto e = cache.find(r.key);
+		if (e != cache.end()) {
+			std::chrono::duration<double> age = Clock::now() - e->second.when;
+			if ((e->second.epoch == epoch) && (age.count() <= opt.maxAge)) {
+				r.bodies = e->second.bodies;
+				stats.hits++;
+				deliver(r, '>');
+				return;
+			}
+		}
+		for (auto *q : {&inflight, &waiting}) {
+			for (auto &other : *q) {
+				if ((other.key == r.key) && (other.epoch == r.epoch)) {
+					other.waiters.push_back(r.waiters[0]);
+					stats.shared++;
+					return;
+				}
+			}
+		}
+	}
+
+	waiting.push_back(r);
+	pump();
+}
+
+static void readClient(int fd)
+{
+	char buf[1024];
+	ssize_t n = recv(fd, buf, sizeof(buf), 0);
+
+	if (n <= 0) {
+		forgetClient(fd);
+		return;
+	}
+	std::string &in = clients[fd].in;
+	in.append(buf, n);
+	size_t eol;
+	while ((eol = in.find_first_of("\r\n")) != std::string::npos) {
+		std::string line = in.substr(0, eol);
+		in.erase(0, eol + 1);
+		clientLine(fd, line);
+		if (clients.find(fd) == clients.end()) {
+			return;
+		}
+	}
+	if (in.size() > 4096) {				// Not a command line
+		forgetClient(fd);
+	}
+}
+
+/*------------------------------------------------------------------------------
+Main loop
+------------------------------------------------------------------------------*/
+static int listenOn(int port)
+{
+	int fd = socket(AF_INET, SOCK_STREAM, 0), one = 1;
+	struct sockaddr_in a;
+
+	if (fd < 0) {
+		return -1;
+	}
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	std::memset(&a, 0, sizeof(a));
+	a.sin_family = AF_INET;
+	a.sin_port = htons(port);
+	a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);	// Local clients only
+	if (bind(fd, (struct sockaddr *) &a, sizeof(a)) < 0 || listen(fd, 16) < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static void usage(void)
+{
+	std::fprintf(stderr, "usage: specmechd -c <host:port | /dev/ttyX> [-l port] "
+		"[-a maxage] [-p depth] [-t timeout] [-v]\n");
+	std::exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "c:l:a:p:t:v")) != -1) {
+		switch (c) {
+			case 'c': opt.target = optarg; break;
+			case 'l': opt.port = std::atoi(optarg); break;
+			case 'a': opt.maxAge = std::atof(optarg); break;
+			case 'p': opt.depth = std::strtoul(optarg, nullptr, 10); break;
+			case 't': opt.timeout = std::atoi(optarg); break;
+			case 'v': opt.verbose = true; break;
+			default: usage();
+		}
+	}
+	if (opt.target.empty() || opt.depth < 1 || opt.depth > STACKSLOTS) {
+		usage();
+	}
+	signal(SIGPIPE, SIG_IGN);
+
+	int listenfd = listenOn(opt.port);
+	if (listenfd < 0) {
+		std::perror("specmechd: listen");
+		return 1;
+	}
+	nextConnect = Clock::now();
+
+	for (;;) {
+		if ((linkfd < 0) && (Clock::now() >= nextConnect)) {
+			openLink();
+			pump();
+		}
+
+		if (!inflight.empty() &&
+			(Clock::now() - inflight.front().sent) > std::chrono::seconds(opt.timeout)) {
+			stats.timeouts++;
+			resync();
+			pump();
+		}
+
+		std::vector<struct pollfd> fds;
+		fds.push_back({listenfd, POLLIN, 0});
+		if (linkfd >= 0) {
+			fds.push_back({linkfd, POLLIN, 0});
+		}
+		for (auto &kv : clients) {
+			short events = POLLIN | (kv.second.out.empty() ? 0 : POLLOUT);
+			fds.push_back({kv.first, events, 0});
+		}
+
+		if (poll(fds.data(), fds.size(), 200) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			std::perror("specmechd: poll");
+			return 1;
+		}
+
+		for (auto &p : fds) {
+			if (!p.revents) {
+				continue;
+			}
+			if (p.fd == listenfd) {
+				int fd = accept(listenfd, nullptr, nullptr);
+				if (fd >= 0) {
+					fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+					clients[fd] = Client{fd, "", "", false};
+				}
+			} else if (p.fd == linkfd) {
+				readLink();
+			} else if (clients.count(p.fd)) {
+				if (p.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+					forgetClient(p.fd);
+					continue;
+				}
+				if (p.revents & POLLOUT) {
+					flushClient(clients[p.fd]);
+				}
+				if (p.revents & POLLIN) {
+					readClient(p.fd);
+				}
+			}
+		}
+	}
+}
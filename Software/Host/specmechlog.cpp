@@ -0,0 +1,1017 @@
+/*------------------------------------------------------------------------------
+specmechlog.cpp
+	Time series archive of specMech output. Raw serial logs go in and come
+	out as column files that are mapped into memory and searched by time:
+
+		specmechlog -d <dir> [-v] [log ...]
+		specmechlog -d <dir> -l
+		specmechlog -d <dir> -q <series> [-f from] [-t to] [-s step]
+
+	Ingest reads the logs (standard input if none are named), keeps the lines
+	whose checksum is there and matches, and decodes them with the
+	sentences.hpp parsers. Sentences in EVT wrappers are unwrapped. Each
+	S<id><TYPE>, and axis for MTR and MTV, is a series, so both spectrographs
+	can share a directory:
+
+		<dir>/S2ENV/columns		Field names and kinds
+		<dir>/S2ENV/time		Seconds since 1970, sorted
+		<dir>/S2ENV/t0			One file per field, fixed width
+		...
+		<dir>/S1MTR.a/position
+
+	The time column is kept sorted, which makes it the index: a query does a
+	binary search on it and reads only the rows in range. New rows later
+	than the series' last one are appended. Earlier or overlapping rows are
+	merged in, and exact repeats (the same log ingested twice) are dropped.
+	A merge writes new files and renames them over the old ones, so the old
+	rows survive a merge cut short.
+
+	Fields are 4-byte floats (f in the schema), 4-byte integers (d), 8-byte
+	times (TIM), or single characters (PNU), in host byte order. A field a
+	short form left out, or a sensor that couldn't be read (BADFLOAT), is
+	NaN or INT32_MIN. ERR has no time of its own and gets the time of the
+	spectrograph's last sentence before it. VER's version (a date) is kept
+	as a time. Sentences that aren't in sentences.def (ALM, LNK, SNP, USE,
+	WDT, WPT, TRJ) are counted but not stored.
+
+	-l lists the series. -q prints a series' rows as CSV, or with -s <step>
+	the count and the minimum, mean, and maximum of each numeric field in
+	<step>-second buckets. Times are YYYY-MM-DD[Thh:mm:ss] controller time,
+	taken as UTC; a date alone for -t means the end of that day.
+------------------------------------------------------------------------------*/
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "nmea.h"
+#include "sentences.hpp"
+
+static const int32_t MISSING = std::numeric_limits<int32_t>::min();
+static const int64_t NOTIME = std::numeric_limits<int64_t>::min();
+static const double BADFLOAT = -666.0;	// globals.h in the firmware
+
+struct Column {
+	std::string name;
+	char kind;						// f float, i int32, l int64 time, c char
+	std::vector<uint8_t> data;
+};
+
+struct Series {
+	std::vector<int64_t> time;
+	std::vector<Column> cols;
+	size_t next = 0;				// Column the row being added is up to
+};
+
+static struct {
+	std::string dir;
+	std::string series;
+	std::string from, to;
+	long step = 0;
+	bool list = false;
+	bool verbose = false;
+} opt;
+
+static struct {
+	unsigned long lines, sentences, badsum, unparsed, badtime, stored, skipped,
+		repeats, rejected;
+} stats;
+
+static std::map<std::string, Series> batch;	// Rows read this run
+static std::map<char, int64_t> lastTime;	// Latest time from each spectrograph
+
+static void say(const char *fmt, ...)
+{
+	if (!opt.verbose) {
+		return;
+	}
+	va_list ap;
+	va_start(ap, fmt);
+	std::vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	std::fputc('\n', stderr);
+}
+
+static size_t width(char kind)
+{
+	switch (kind) {
+		case 'c': return 1;
+		case 'l': return 8;
+		default: return 4;
+	}
+}
+
+/*------------------------------------------------------------------------------
+Time
+------------------------------------------------------------------------------*/
+
+// Seconds since 1970 from YYYY-MM-DD or YYYY-MM-DDThh:mm:ss
+static bool parseTime(std::string_view s, int64_t &t)
+{
+	static const size_t at[6] = {0, 5, 8, 11, 14, 17}, len[6] = {4, 2, 2, 2, 2, 2};
+	int v[6] = {0, 0, 0, 0, 0, 0};
+
+	if ((s.size() != 10 && s.size() != 19) || s[4] != '-' || s[7] != '-') {
+		return false;
+	}
+	if (s.size() == 19 && (s[10] != 'T' || s[13] != ':' || s[16] != ':')) {
+		return false;
+	}
+	for (size_t i = 0; i < (s.size() == 10 ? 3 : 6); i++) {
+		for (size_t j = 0; j < len[i]; j++) {
+			char c = s[at[i] + j];
+			if (c < '0' || c > '9') {
+				return false;
+			}
+			v[i] = (v[i] * 10) + (c - '0');
+		}
+	}
+	if (v[1] < 1 || v[1] > 12 || v[2] < 1 || v[2] > 31 || v[3] > 23 ||
+		v[4] > 59 || v[5] > 60) {
+		return false;
+	}
+
+	int64_t y = v[0] - (v[1] <= 2);		// Days from the civil date
+	int64_t era = (y >= 0 ? y : y - 399) / 400;
+	int64_t yoe = y - (era * 400);
+	int64_t doy = (((153 * (v[1] + (v[1] > 2 ? -3 : 9))) + 2) / 5) + v[2] - 1;
+	int64_t doe = (yoe * 365) + (yoe / 4) - (yoe / 100) + doy;
+	int64_t days = (era * 146097) + doe - 719468;
+
+	t = (days * 86400) + (v[3] * 3600) + (v[4] * 60) + v[5];
+	return true;
+}
+
+static std::string formatTime(int64_t t)
+{
+	char buf[32];
+	time_t tt = (time_t) t;
+	struct tm tm;
+
+	gmtime_r(&tt, &tm);
+	std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm);
+	return buf;
+}
+
+/*------------------------------------------------------------------------------
+Decoding
+------------------------------------------------------------------------------*/
+
+// Start a row in a series. The columns are made by the first row's put()s
+// and every later row puts the same fields in the same order.
+static Series &row(char id, const std::string &name, int64_t t)
+{
+	Series &s = batch[std::string("S") + id + name];
+	s.time.push_back(t);
+	s.next = 0;
+	lastTime[id] = t;
+	stats.stored++;
+	return s;
+}
+
+static void put(Series &s, const char *name, char kind, const void *v)
+{
+	if (s.next == s.cols.size()) {
+		s.cols.push_back(Column{name, kind, {}});
+	}
+	Column &c = s.cols[s.next++];
+	const uint8_t *p = (const uint8_t *) v;
+	c.data.insert(c.data.end(), p, p + width(kind));
+}
+
+static void putF(Series &s, const char *name, double v, bool have = true)
+{
+	float f = (have && v != BADFLOAT) ? (float) v : NAN;
+	put(s, name, 'f', &f);
+}
+
+static void putI(Series &s, const char *name, long v, bool have = true)
+{
+	int32_t i = have ? (int32_t) v : MISSING;
+	put(s, name, 'i', &i);
+}
+
+static void putL(Series &s, const char *name, std::string_view v)
+{
+	int64_t t;
+	if (!parseTime(v, t)) {
+		t = NOTIME;
+	}
+	put(s, name, 'l', &t);
+}
+
+static void putC(Series &s, const char *name, char v)
+{
+	put(s, name, 'c', &v);
+}
+
+// Parse a sentence that starts with a time
+template <typename T>
+static bool parsed(std::string_view body, T &v, int64_t &t)
+{
+	if (!sentences::parse(body, v)) {
+		stats.unparsed++;
+		return false;
+	}
+	if (!parseTime(v.time, t)) {
+		stats.badtime++;
+		return false;
+	}
+	return true;
+}
+
+static void decode(std::string_view body)
+{
+	using namespace sentences;
+	char id = body[1];
+	int64_t t;
+
+	switch (type(body)) {
+		case Type::CMD: {
+			CMD v;
+			if (parsed(body, v, t)) {
+				Series &s = row(id, "CMD", t);
+				putI(s, "wait", v.wait);
+			}
+			return;
+		}
+
+		case Type::ENV: {
+			ENV v;
+			if (parsed(body, v, t)) {
+				bool wt = want(v.select, 't'), wh = want(v.select, 'h');
+				Series &s = row(id, "ENV", t);
+				putF(s, "t0", v.t0, wt);
+				putF(s, "h0", v.h0, wh);
+				putF(s, "t1", v.t1, wt);
+				putF(s, "h1", v.h1, wh);
+				putF(s, "t2", v.t2, wt);
+				putF(s, "h2", v.h2, wh);
+				putF(s, "t3", v.t3, wt);
+			}
+			return;
+		}
+
+		case Type::ERR: {
+			ERR v;
+			if (!parse(body, v)) {
+				stats.unparsed++;
+			} else if (lastTime.find(id) == lastTime.end()) {
+				stats.badtime++;
+			} else {
+				Series &s = row(id, "ERR", lastTime[id]);
+				putI(s, "code", v.code);
+			}
+			return;
+		}
+
+		case Type::EXP: {
+			EXP v;
+			if (parsed(body, v, t)) {
+				Series &s = row(id, "EXP", t);
+				putI(s, "late", v.late);
+				putI(s, "wait", v.wait);
+			}
+			return;
+		}
+
+		case Type::MTR: {
+			MTR v;
+			if (parsed(body, v, t)) {
+				Series &s = row(id, std::string("MTR.") + v.axis, t);
+				putI(s, "position", v.position, want(v.select, 'p'));
+				putI(s, "speed", v.speed, want(v.select, 's'));
+				putI(s, "current", v.current, want(v.select, 'c'));
+			}
+			return;
+		}
+
+		case Type::MTV: {
+			MTV v;
+			if (parsed(body, v, t)) {
+				Series &s = row(id, std::string("MTV.") + v.axis, t);
+				putF(s, "volts", v.volts, want(v.select, 'v'));
+				putF(s, "temperature", v.temperature, want(v.select, 't'));
+			}
+			return;
+		}
+
+		case Type::ORI: {
+			ORI v;
+			if (parsed(body, v, t)) {
+				Series &s = row(id, "ORI", t);
+				putF(s, "x", v.x);
+				putF(s, "y", v.y);
+				putF(s, "z", v.z);
+			}
+			return;
+		}
+
+		case Type::PNU: {
+			PNU v;
+			if (parsed(body, v, t)) {
+				Series &s = row(id, "PNU", t);
+				putC(s, "shutter", v.shutter);
+				putC(s, "left", v.left);
+				putC(s, "right", v.right);
+				putC(s, "air", v.air);
+			}
+			return;
+		}
+
+		case Type::QUE: {
+			QUE v;
+			if (parsed(body, v, t)) {
+				Series &s = row(id, "QUE", t);
+				putI(s, "commands", v.commands);
+				putI(s, "expired", v.expired);
+				putI(s, "last", v.last);
+				putI(s, "max", v.max);
+			}
+			return;
+		}
+
+		case Type::TIM: {
+			TIM v;
+			if (parsed(body, v, t)) {
+				Series &s = row(id, "TIM", t);
+				putL(s, "settime", v.settime);
+				putL(s, "boottime", v.boottime);
+			}
+			return;
+		}
+
+		case Type::VAC: {
+			VAC v;
+			if (parsed(body, v, t)) {
+				Series &s = row(id, "VAC", t);
+				putF(s, "red", v.red, want(v.select, 'r'));
+				putF(s, "blue", v.blue, want(v.select, 'b'));
+			}
+			return;
+		}
+
+		case Type::VER: {
+			VER v;
+			if (parsed(body, v, t)) {
+				Series &s = row(id, "VER", t);
+				putL(s, "version", v.version);
+			}
+			return;
+		}
+
+		default:						// Types not in the schema
+			stats.skipped++;
+			return;
+	}
+}
+
+static void ingestLine(std::string_view line)
+{
+	bool ok;
+	std::string inner;
+
+	stats.lines++;
+	size_t dollar = line.find('$');		// Prompts can come first
+	if (dollar == std::string_view::npos) {
+		return;
+	}
+	std::string_view body = nmea::body_view(line.substr(dollar), ok);
+	if (!ok) {
+		stats.badsum++;
+		return;
+	}
+	stats.sentences++;
+	if (body.size() < 3 || body[0] != 'S') {
+		stats.unparsed++;
+		return;
+	}
+
+	if (body.substr(2, 4) == "EVT,") {	// S2EVT,<seq>,<sentence>
+		size_t comma = body.find(',', 6);
+		if (comma == std::string_view::npos) {
+			stats.unparsed++;
+			return;
+		}
+		inner.assign(body.substr(0, 2));
+		inner.append(body.substr(comma + 1));
+		body = inner;
+	}
+	decode(body);
+}
+
+static bool ingestFile(FILE *fp)
+{
+	std::vector<char> buf(1 << 20);
+	std::string partial;
+	size_t n;
+
+	while ((n = std::fread(buf.data(), 1, buf.size(), fp)) > 0) {
+		std::string_view chunk(buf.data(), n);
+		size_t eol;
+		if (!partial.empty()) {			// Finish the line the last chunk cut
+			eol = chunk.find('\n');
+			if (eol == std::string_view::npos) {
+				partial.append(chunk);
+				continue;
+			}
+			partial.append(chunk.substr(0, eol + 1));
+			ingestLine(partial);
+			partial.clear();
+			chunk.remove_prefix(eol + 1);
+		}
+		while ((eol = chunk.find('\n')) != std::string_view::npos) {
+			ingestLine(chunk.substr(0, eol + 1));
+			chunk.remove_prefix(eol + 1);
+		}
+		partial.assign(chunk);
+	}
+	if (!partial.empty()) {
+		ingestLine(partial);
+	}
+	return !std::ferror(fp);
+}
+
+/*------------------------------------------------------------------------------
+Column files
+------------------------------------------------------------------------------*/
+static std::string path(const std::string &series, const std::string &file)
+{
+	return opt.dir + "/" + series + "/" + file;
+}
+
+// Read a series' columns file. False if there isn't one.
+static bool readColumns(const std::string &series, std::vector<Column> &cols)
+{
+	FILE *fp = std::fopen(path(series, "columns").c_str(), "r");
+	char name[64], kind;
+
+	if (!fp) {
+		return false;
+	}
+	cols.clear();
+	while (std::fscanf(fp, "%63s %c", name, &kind) == 2) {
+		cols.push_back(Column{name, kind, {}});
+	}
+	std::fclose(fp);
+	return true;
+}
+
+static bool writeColumns(const std::string &series, const std::vector<Column> &cols)
+{
+	FILE *fp = std::fopen(path(series, "columns").c_str(), "w");
+
+	if (!fp) {
+		return false;
+	}
+	for (auto &c : cols) {
+		std::fprintf(fp, "%s %c\n", c.name.c_str(), c.kind);
+	}
+	return std::fclose(fp) == 0;
+}
+
+static size_t fileSize(const std::string &p)
+{
+	struct stat st;
+	return (stat(p.c_str(), &st) == 0) ? (size_t) st.st_size : 0;
+}
+
+// Rows every file in a series has
+static size_t rowsOnDisk(const std::string &series, const std::vector<Column> &cols)
+{
+	size_t rows = fileSize(path(series, "time")) / 8;
+
+	for (auto &c : cols) {
+		rows = std::min(rows, fileSize(path(series, c.name)) / width(c.kind));
+	}
+	return rows;
+}
+
+// An append cut short leaves some files longer than others. Cut them back
+// to the rows every file has.
+static size_t trimRows(const std::string &series, const std::vector<Column> &cols)
+{
+	size_t rows = rowsOnDisk(series, cols);
+
+	if (truncate(path(series, "time").c_str(), rows * 8) != 0 && errno != ENOENT) {
+		return 0;
+	}
+	for (auto &c : cols) {
+		if (truncate(path(series, c.name).c_str(), rows * width(c.kind)) != 0 &&
+			errno != ENOENT) {
+			return 0;
+		}
+	}
+	return rows;
+}
+
+// A merge writes each field to <field>.new, then time.tmp, which is renamed
+// to time.new once it is whole, and renames them all over the old files in
+// the same order. If time.new is there, every new file was finished and a
+// merge cut short during the renames is finished here. Otherwise any new
+// files are from a cut-short write and are removed, leaving the old rows.
+static bool finishMerge(const std::string &series, const std::vector<Column> &cols)
+{
+	std::string time = path(series, "time");
+	bool done = (access((time + ".new").c_str(), F_OK) == 0);
+
+	if (!done) {
+		std::remove((time + ".tmp").c_str());
+	}
+	for (auto &c : cols) {
+		std::string p = path(series, c.name);
+		if (!done) {
+			std::remove((p + ".new").c_str());
+		} else if (std::rename((p + ".new").c_str(), p.c_str()) != 0 && errno != ENOENT) {
+			return false;
+		}
+	}
+	return !done || (std::rename((time + ".new").c_str(), time.c_str()) == 0);
+}
+
+static bool writeFile(const std::string &p, const void *data, size_t n, const char *mode)
+{
+	FILE *fp = std::fopen(p.c_str(), mode);
+
+	if (!fp) {
+		return false;
+	}
+	bool ok = (n == 0) || (std::fwrite(data, 1, n, fp) == n);
+	return (std::fclose(fp) == 0) && ok;
+}
+
+static bool readFile(const std::string &p, std::vector<uint8_t> &data, size_t n)
+{
+	FILE *fp = std::fopen(p.c_str(), "r");
+
+	if (!fp) {
+		return false;
+	}
+	data.resize(n);
+	bool ok = (n == 0) || (std::fread(data.data(), 1, n, fp) == n);
+	std::fclose(fp);
+	return ok;
+}
+
+static bool sameRow(const Series &s, size_t a, size_t b)
+{
+	for (auto &c : s.cols) {
+		size_t w = width(c.kind);
+		if (std::memcmp(&c.data[a * w], &c.data[b * w], w) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Sort a series' rows by time and drop rows that repeat one at the same time
+static void tidy(Series &s)
+{
+	std::vector<size_t> order(s.time.size()), keep;
+
+	std::iota(order.begin(), order.end(), 0);
+	if (!std::is_sorted(s.time.begin(), s.time.end())) {
+		std::stable_sort(order.begin(), order.end(),
+			[&s](size_t a, size_t b) { return s.time[a] < s.time[b]; });
+	}
+
+	size_t group = 0;					// First kept row at this time
+	for (size_t i = 0; i < order.size(); i++) {
+		if (!keep.empty() && s.time[order[i]] != s.time[keep.back()]) {
+			group = keep.size();
+		}
+		bool repeat = false;
+		for (size_t j = group; j < keep.size() && !repeat; j++) {
+			repeat = sameRow(s, keep[j], order[i]);
+		}
+		if (repeat) {
+			stats.repeats++;
+		} else {
+			keep.push_back(order[i]);
+		}
+	}
+
+	std::vector<int64_t> time(keep.size());
+	for (size_t i = 0; i < keep.size(); i++) {
+		time[i] = s.time[keep[i]];
+	}
+	s.time.swap(time);
+	for (auto &c : s.cols) {
+		size_t w = width(c.kind);
+		std::vector<uint8_t> data(keep.size() * w);
+		for (size_t i = 0; i < keep.size(); i++) {
+			std::memcpy(&data[i * w], &c.data[keep[i] * w], w);
+		}
+		c.data.swap(data);
+	}
+}
+
+// Add this run's rows for one series to its files
+static bool store(const std::string &name, Series &s)
+{
+	std::vector<Column> disk;
+	size_t rows = 0;
+
+	mkdir((opt.dir + "/" + name).c_str(), 0777);
+	if (readColumns(name, disk)) {
+		bool same = (disk.size() == s.cols.size());
+		for (size_t i = 0; same && i < disk.size(); i++) {
+			same = (disk[i].name == s.cols[i].name) && (disk[i].kind == s.cols[i].kind);
+		}
+		if (!same) {
+			std::fprintf(stderr, "specmechlog: %s has different columns, not changed\n",
+				name.c_str());
+			stats.rejected += s.time.size();
+			return false;
+		}
+		if (!finishMerge(name, disk)) {
+			return false;
+		}
+		rows = trimRows(name, disk);
+	} else if (!writeColumns(name, s.cols)) {
+		return false;
+	}
+
+	tidy(s);
+	int64_t last = NOTIME;
+	if (rows > 0) {
+		FILE *fp = std::fopen(path(name, "time").c_str(), "r");
+		if (fp && std::fseek(fp, (long) ((rows - 1) * 8), SEEK_SET) == 0) {
+			if (std::fread(&last, 8, 1, fp) != 1) {
+				last = NOTIME;
+			}
+		}
+		if (fp) {
+			std::fclose(fp);
+		}
+	}
+
+	if ((rows > 0) && (s.time.front() <= last)) {	// Merge with what's there
+		say("%s: merging %zu rows into %zu", name.c_str(), s.time.size(), rows);
+		Series old;
+		std::vector<uint8_t> data;
+		if (!readFile(path(name, "time"), data, rows * 8)) {
+			return false;
+		}
+		old.time.resize(rows);
+		std::memcpy(old.time.data(), data.data(), rows * 8);
+		old.time.insert(old.time.end(), s.time.begin(), s.time.end());
+		old.cols = disk;
+		for (size_t i = 0; i < old.cols.size(); i++) {
+			if (!readFile(path(name, old.cols[i].name), old.cols[i].data,
+				rows * width(old.cols[i].kind))) {
+				return false;
+			}
+			old.cols[i].data.insert(old.cols[i].data.end(), s.cols[i].data.begin(),
+				s.cols[i].data.end());
+		}
+		unsigned long before = stats.repeats;
+		tidy(old);
+		say("%s: %lu repeats", name.c_str(), stats.repeats - before);
+		s.time.swap(old.time);
+		s.cols.swap(old.cols);
+
+		// New files, time.new last, then renamed in the same order (finishMerge)
+		std::string time = path(name, "time");
+		for (auto &c : s.cols) {
+			if (!writeFile(path(name, c.name) + ".new", c.data.data(), c.data.size(), "w")) {
+				return false;
+			}
+		}
+		if (!writeFile(time + ".tmp", s.time.data(), s.time.size() * 8, "w") ||
+			(std::rename((time + ".tmp").c_str(), (time + ".new").c_str()) != 0)) {
+			return false;
+		}
+		return finishMerge(name, s.cols);
+	}
+
+	say("%s: appending %zu rows to %zu", name.c_str(), s.time.size(), rows);
+
+	// Fields first and time last, so an append cut short is undone by trimRows
+	for (auto &c : s.cols) {
+		if (!writeFile(path(name, c.name), c.data.data(), c.data.size(), "a")) {
+			return false;
+		}
+	}
+	return writeFile(path(name, "time"), s.time.data(), s.time.size() * 8, "a");
+}
+
+/*------------------------------------------------------------------------------
+Queries
+------------------------------------------------------------------------------*/
+struct Mapped {
+	const uint8_t *p = nullptr;
+	size_t size = 0;
+};
+
+static Mapped mapFile(const std::string &p)
+{
+	Mapped m;
+	int fd = open(p.c_str(), O_RDONLY);
+
+	if (fd < 0) {
+		return m;
+	}
+	m.size = fileSize(p);
+	if (m.size > 0) {
+		void *a = mmap(nullptr, m.size, PROT_READ, MAP_SHARED, fd, 0);
+		if (a == MAP_FAILED) {
+			m.size = 0;
+		} else {
+			m.p = (const uint8_t *) a;
+		}
+	}
+	close(fd);
+	return m;
+}
+
+static std::vector<std::string> seriesNames(void)
+{
+	std::vector<std::string> names;
+	DIR *d = opendir(opt.dir.c_str());
+	struct dirent *e;
+
+	if (!d) {
+		return names;
+	}
+	while ((e = readdir(d)) != nullptr) {
+		std::vector<Column> cols;
+		if (e->d_name[0] != '.' && readColumns(e->d_name, cols)) {
+			names.push_back(e->d_name);
+		}
+	}
+	closedir(d);
+	std::sort(names.begin(), names.end());
+	return names;
+}
+
+static int list(void)
+{
+	for (auto &name : seriesNames()) {
+		std::vector<Column> cols;
+		readColumns(name, cols);
+		Mapped t = mapFile(path(name, "time"));
+		size_t rows = t.size / 8;
+		std::printf("%-10s %10zu rows", name.c_str(), rows);
+		if (rows > 0) {
+			const int64_t *time = (const int64_t *) t.p;
+			std::printf("  %s to %s", formatTime(time[0]).c_str(),
+				formatTime(time[rows - 1]).c_str());
+			munmap((void *) t.p, t.size);
+		}
+		for (auto &c : cols) {
+			std::printf(" %s", c.name.c_str());
+		}
+		std::printf("\n");
+	}
+	return 0;
+}
+
+static void printValue(const Column &c, const uint8_t *p)
+{
+	float f;
+	int32_t i;
+	int64_t l;
+
+	switch (c.kind) {
+		case 'f':
+			std::memcpy(&f, p, 4);
+			if (!std::isnan(f)) {
+				std::printf("%.6g", f);
+			}
+			break;
+
+		case 'i':
+			std::memcpy(&i, p, 4);
+			if (i != MISSING) {
+				std::printf("%d", i);
+			}
+			break;
+
+		case 'l':
+			std::memcpy(&l, p, 8);
+			if (l != NOTIME) {
+				std::printf("%s", formatTime(l).c_str());
+			}
+			break;
+
+		case 'c':
+			std::printf("%c", *p);
+			break;
+	}
+}
+
+// A numeric field's value as a double, false if it's missing or not a number
+static bool number(const Column &c, const uint8_t *p, double &v)
+{
+	float f;
+	int32_t i;
+
+	if (c.kind == 'f') {
+		std::memcpy(&f, p, 4);
+		v = f;
+		return !std::isnan(f);
+	}
+	if (c.kind == 'i') {
+		std::memcpy(&i, p, 4);
+		v = i;
+		return i != MISSING;
+	}
+	return false;
+}
+
+struct Summary {
+	unsigned long n = 0;
+	double min = 0.0, max = 0.0, sum = 0.0;
+};
+
+static int query(void)
+{
+	std::vector<Column> cols;
+	int64_t from = std::numeric_limits<int64_t>::min(), to = std::numeric_limits<int64_t>::max();
+
+	if (!readColumns(opt.series, cols)) {
+		std::fprintf(stderr, "specmechlog: no series %s in %s\n", opt.series.c_str(),
+			opt.dir.c_str());
+		return 1;
+	}
+	if ((!opt.from.empty() && !parseTime(opt.from, from)) ||
+		(!opt.to.empty() && !parseTime(opt.to, to))) {
+		std::fprintf(stderr, "specmechlog: times are YYYY-MM-DD[Thh:mm:ss]\n");
+		return 1;
+	}
+	if (opt.to.size() == 10) {
+		to += 86399;
+	}
+
+	size_t rows = rowsOnDisk(opt.series, cols);
+	Mapped t = mapFile(path(opt.series, "time"));
+	std::vector<Mapped> m;
+	for (auto &c : cols) {
+		m.push_back(mapFile(path(opt.series, c.name)));
+	}
+	if (rows == 0 || !t.p) {
+		return 0;
+	}
+	const int64_t *time = (const int64_t *) t.p;
+	size_t lo = std::lower_bound(time, time + rows, from) - time;
+	size_t hi = std::upper_bound(time, time + rows, to) - time;
+
+	std::printf("time");
+	if (opt.step > 0) {
+		std::printf(",rows");
+		for (auto &c : cols) {
+			if (c.kind == 'f' || c.kind == 'i') {
+				std::printf(",%s.min,%s.mean,%s.max", c.name.c_str(), c.name.c_str(),
+					c.name.c_str());
+			}
+		}
+	} else {
+		for (auto &c : cols) {
+			std::printf(",%s", c.name.c_str());
+		}
+	}
+	std::printf("\n");
+
+	if (opt.step <= 0) {
+		for (size_t r = lo; r < hi; r++) {
+			std::printf("%s", formatTime(time[r]).c_str());
+			for (size_t i = 0; i < cols.size(); i++) {
+				std::printf(",");
+				printValue(cols[i], m[i].p + (r * width(cols[i].kind)));
+			}
+			std::printf("\n");
+		}
+		return 0;
+	}
+
+	size_t r = lo;
+	while (r < hi) {
+		int64_t start = time[r] - (((time[r] % opt.step) + opt.step) % opt.step);
+		size_t end = std::lower_bound(time + r, time + hi, start + opt.step) - time;
+		std::printf("%s,%zu", formatTime(start).c_str(), end - r);
+		for (size_t i = 0; i < cols.size(); i++) {
+			if (cols[i].kind != 'f' && cols[i].kind != 'i') {
+				continue;
+			}
+			Summary s;
+			size_t w = width(cols[i].kind);
+			for (size_t k = r; k < end; k++) {
+				double v;
+				if (!number(cols[i], m[i].p + (k * w), v)) {
+					continue;
+				}
+				if (s.n == 0 || v < s.min) {
+					s.min = v;
+				}
+				if (s.n == 0 || v > s.max) {
+					s.max = v;
+				}
+				s.sum += v;
+				s.n++;
+			}
+			if (s.n > 0) {
+				std::printf(",%.6g,%.6g,%.6g", s.min, s.sum / s.n, s.max);
+			} else {
+				std::printf(",,,");
+			}
+		}
+		std::printf("\n");
+		r = end;
+	}
+	return 0;
+}
+
+/*------------------------------------------------------------------------------
+Main
+------------------------------------------------------------------------------*/
+static void usage(void)
+{
+	std::fprintf(stderr,
+		"usage: specmechlog -d <dir> [-v] [log ...]\n"
+		"       specmechlog -d <dir> -l\n"
+		"       specmechlog -d <dir> -q <series> [-f from] [-t to] [-s step]\n");
+	std::exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "d:lq:f:t:s:v")) != -1) {
+		switch (c) {
+			case 'd': opt.dir = optarg; break;
+			case 'l': opt.list = true; break;
+			case 'q': opt.series = optarg; break;
+			case 'f': opt.from = optarg; break;
+			case 't': opt.to = optarg; break;
+			case 's': opt.step = std::atol(optarg); break;
+			case 'v': opt.verbose = true; break;
+			default: usage();
+		}
+	}
+	if (opt.dir.empty()) {
+		usage();
+	}
+	if (opt.list) {
+		return list();
+	}
+	if (!opt.series.empty()) {
+		return query();
+	}
+
+	if (mkdir(opt.dir.c_str(), 0777) != 0 && errno != EEXIST) {
+		std::perror("specmechlog: mkdir");
+		return 1;
+	}
+	if (optind == argc) {
+		ingestFile(stdin);
+	}
+	for (int i = optind; i < argc; i++) {
+		FILE *fp = std::fopen(argv[i], "r");
+		if (!fp) {
+			std::fprintf(stderr, "specmechlog: can't open %s: %s\n", argv[i],
+				std::strerror(errno));
+			return 1;
+		}
+		unsigned long before = stats.stored;
+		if (!ingestFile(fp)) {
+			std::fprintf(stderr, "specmechlog: error reading %s\n", argv[i]);
+		}
+		std::fclose(fp);
+		say("%s: %lu rows", argv[i], stats.stored - before);
+	}
+
+	int status = 0;
+	for (auto &kv : batch) {
+		if (!store(kv.first, kv.second)) {
+			std::fprintf(stderr, "specmechlog: can't write %s: %s\n", kv.first.c_str(),
+				std::strerror(errno));
+			status = 1;
+		}
+	}
+
+	std::fprintf(stderr, "lines %lu sentences %lu badchecksum %lu unparsed %lu "
+		"badtime %lu stored %lu notstored %lu repeats %lu rejected %lu\n",
+		stats.lines, stats.sentences, stats.badsum, stats.unparsed, stats.badtime,
+		stats.stored, stats.skipped, stats.repeats, stats.rejected);
+	return status;
+}